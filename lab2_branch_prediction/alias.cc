@@ -0,0 +1,33 @@
+#include "alias.h"
+#include "predictor.h"
+
+static double Percent(UINT64 part, UINT64 whole) {
+  return whole ? 100.0 * (double)part / (double)whole : 0.0;
+}
+
+std::string AliasReport(const AliasStats &st) {
+  UINT64 aliased = st.constructive + st.destructive + st.neutral;
+  char buf[512];
+  int n = snprintf(buf, sizeof(buf),
+                   "    counters: %llu accesses, %.2f%% first use, %.2f%% aliased "
+                   "(constructive %.2f%%, destructive %.2f%%, neutral %.2f%%)\n"
+                   "    mispredictions: %llu, %llu from destructive aliasing (%.2f%%), "
+                   "%llu with private counters\n",
+                   (unsigned long long)st.accesses, Percent(st.firstUse, st.accesses), Percent(aliased, st.accesses),
+                   Percent(st.constructive, st.accesses), Percent(st.destructive, st.accesses),
+                   Percent(st.neutral, st.accesses), (unsigned long long)st.mispred,
+                   (unsigned long long)st.destructive, Percent(st.destructive, st.mispred),
+                   (unsigned long long)st.idealMispred);
+  if (st.histAccesses > 0 && n > 0 && (size_t)n < sizeof(buf)) {
+    snprintf(buf + n, sizeof(buf) - n, "    history table: %.2f%% of %llu reads last written by another branch\n",
+             Percent(st.histShared, st.histAccesses), (unsigned long long)st.histAccesses);
+  }
+  return buf;
+}
+
+void RegisterAliasShadows() {
+  RegisterAliasShadow<Predictor_2bitsat>("2bitsat");
+  RegisterAliasShadow<Predictor_2level>("2level");
+  RegisterAliasShadow<Predictor_openend>("openend");
+  RegisterAliasShadow<Predictor_pshare>("pshare");
+}
@@ -0,0 +1,156 @@
+#ifndef _ALIAS_H_
+#define _ALIAS_H_
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bpsim.h"
+#include "packed_counters.h"
+
+/////////////////////////////////////////////////////////////
+// aliasing shadow
+/////////////////////////////////////////////////////////////
+/*
+AliasShadow<P> runs predictor template P unchanged and watches its
+counter table (and the history table of local predictors):
+
+  lastKey[i]   PatternKey (PC and history) that last trained counter i
+  ideal        one private counter per PatternKey, as if the table
+               were infinite and nothing aliased
+
+An access whose counter was last trained by another PatternKey is
+aliased. It is constructive when the shared counter is right and the
+private one wrong, destructive in the opposite case and neutral when
+both agree. Destructive accesses are the mispredictions a conflict
+free table of the same history would have avoided; the rest of the
+mispredictions are made by the private counters too.
+For local predictors the history register read by each branch is
+checked against the last branch that shifted into it.
+
+The shadow drives P's tables (same stateId), so alias-<name> cannot
+run in the same pass as <name>.
+*/
+
+#define ALIAS_EMPTY (~0ull)
+
+struct AliasStats {
+  UINT64 accesses;
+  UINT64 firstUse;
+  UINT64 constructive;
+  UINT64 destructive;
+  UINT64 neutral;
+  UINT64 mispred;
+  UINT64 idealMispred;
+  UINT64 histAccesses;
+  UINT64 histShared;
+};
+
+std::string AliasReport(const AliasStats &st);
+
+template <class P>
+struct AliasShadow {
+  static const unsigned kCtrBits = P::Table::kBits;
+  static const unsigned kCtrMax = (1u << kCtrBits) - 1;
+
+  struct State {
+    std::vector<uint64_t> lastKey;
+    std::vector<UINT32> lastHistPC;
+    std::unordered_map<uint64_t, uint8_t> ideal;
+    AliasStats stats;
+  };
+
+  static thread_local State s;
+
+  static void Init() {
+    P::Init();
+    s.lastKey.assign(P::kCounters, ALIAS_EMPTY);
+    s.lastHistPC.assign(P::kHistoryEntries, 0);
+    s.ideal.clear();
+    s.stats = AliasStats();
+  }
+
+  static bool Get(UINT32 PC) {
+    return P::Get(PC);
+  }
+
+  static void Update(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
+    AliasStats &st = s.stats;
+    UINT32 idx = P::CounterIndex(PC);
+    uint64_t key = P::PatternKey(PC);
+
+    std::pair<typename std::unordered_map<uint64_t, uint8_t>::iterator, bool> ins =
+        s.ideal.insert(std::make_pair(key, (uint8_t)WEAK_NOT_TAKEN(kCtrBits)));
+    uint8_t &ideal = ins.first->second;
+    bool idealDir = (ideal >> (kCtrBits - 1)) & 0x1;
+
+    st.accesses++;
+    st.mispred += (predDir != resolveDir);
+    st.idealMispred += (idealDir != resolveDir);
+
+    uint64_t &last = s.lastKey[idx];
+    if (last == ALIAS_EMPTY) {
+      st.firstUse++;
+    }
+    else if (last != key) {
+      if (predDir == resolveDir && idealDir != resolveDir) {
+        st.constructive++;
+      }
+      else if (predDir != resolveDir && idealDir == resolveDir) {
+        st.destructive++;
+      }
+      else {
+        st.neutral++;
+      }
+    }
+    last = key;
+
+    if (resolveDir == TAKEN) {
+      if (ideal < kCtrMax) {
+        ideal++;
+      }
+    }
+    else {
+      if (ideal > 0) {
+        ideal--;
+      }
+    }
+
+    if (P::kHistoryEntries > 0) {
+      UINT32 &histPC = s.lastHistPC[P::HistoryIndex(PC)];
+      st.histAccesses++;
+      st.histShared += (histPC != 0 && histPC != PC);
+      histPC = PC;
+    }
+
+    P::Update(PC, resolveDir, predDir, branchTarget);
+  }
+
+  static std::string Report() {
+    return AliasReport(s.stats);
+  }
+};
+
+template <class P>
+thread_local typename AliasShadow<P>::State AliasShadow<P>::s;
+
+// registers alias-<name> for template P
+template <class P>
+void RegisterAliasShadow(const char *name) {
+  typedef AliasShadow<P> A;
+  std::string aliasName = std::string("alias-") + name;
+  PredictorDesc &desc = RegisterPredictor(strdup(aliasName.c_str()), A::Init, A::Get, A::Update, P::kStorageBits);
+  desc.stateId = P::Init;
+  desc.Report = A::Report;
+  // a checkpoint holds P's tables, the shadow restarts from it
+  desc.Save = P::Save;
+  desc.Restore = P::Restore;
+}
+
+// alias-<name> for the counter based predictors of predictor.h
+void RegisterAliasShadows();
+
+#endif
@@ -0,0 +1,298 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "bpsim.h"
+
+/////////////////////////////////////////////////////////////
+// predictor throughput benchmark
+/////////////////////////////////////////////////////////////
+/*
+Measures host nanoseconds per Get+Update pair of every selected
+predictor, to catch speed regressions in the lookup and update code.
+
+Streams are held in memory before timing, so decoding is not measured:
+
+  random   1024 static branches, uniform PCs, 50/50 outcomes
+  biased   4096 static branches, each taken with its own fixed
+           probability of 5% or 95%
+  loop     nested loops with trip counts 3..64, the branches of a
+           loop body mostly taken
+  <trace>  the first -n records of each trace given (CBP or .bpt)
+
+For each predictor and stream the predictor is reinitialized and run
+over the stream -w times untimed (warm-up of the host caches and
+branch predictors, the predictor tables are reset before every run),
+then -r timed runs. Reported are the median, mean, standard deviation
+and minimum ns per conditional branch over the timed runs, plus the
+misprediction rate as a check that the runs did real work.
+-c pins the process to one CPU (Linux) so the runs do not migrate
+between cores.
+
+usage: bpbench [-g] [-n records] [-w warmup] [-r runs] [-c cpu] [-p name[,name...]] [<trace> ...]
+*/
+
+#define BENCH_DEFAULT_RECORDS 1000000
+#define BENCH_DEFAULT_WARMUP 2
+#define BENCH_DEFAULT_RUNS 10
+
+struct BenchStream {
+  std::string name;
+  std::vector<BranchRecord> records;
+  UINT64 numCondBr;
+};
+
+static UINT32 Xorshift(UINT32 *seed) {
+  *seed ^= *seed << 13;
+  *seed ^= *seed >> 17;
+  *seed ^= *seed << 5;
+  return *seed;
+}
+
+static BranchRecord CondBranch(UINT32 PC, bool taken) {
+  BranchRecord rec;
+  rec.PC = PC;
+  rec.branchTarget = taken ? PC - 64 : PC + 4;
+  rec.instGap = 5;
+  rec.opType = OPTYPE_BRANCH_COND;
+  rec.taken = taken;
+  return rec;
+}
+
+static void Finish(BenchStream *stream) {
+  stream->numCondBr = 0;
+  for (size_t i = 0; i < stream->records.size(); i++) {
+    stream->numCondBr += stream->records[i].opType == OPTYPE_BRANCH_COND;
+  }
+}
+
+static BenchStream RandomStream(size_t n) {
+  BenchStream stream;
+  stream.name = "random";
+  UINT32 seed = 0x9E3779B9;
+  for (size_t i = 0; i < n; i++) {
+    UINT32 r = Xorshift(&seed);
+    stream.records.push_back(CondBranch(0x400000 + (r % 1024) * 4, (r >> 16) & 1));
+  }
+  Finish(&stream);
+  return stream;
+}
+
+static BenchStream BiasedStream(size_t n) {
+  BenchStream stream;
+  stream.name = "biased";
+  UINT32 seed = 0x2545F491;
+  for (size_t i = 0; i < n; i++) {
+    UINT32 branch = Xorshift(&seed) % 4096;
+    // the low bit of a hash of the branch picks its bias
+    bool mostlyTaken = ((branch * 2654435761u) >> 31) & 1;
+    bool exception = Xorshift(&seed) % 100 < 5;
+    stream.records.push_back(CondBranch(0x400000 + branch * 4, mostlyTaken != exception));
+  }
+  Finish(&stream);
+  return stream;
+}
+
+static BenchStream LoopStream(size_t n) {
+  BenchStream stream;
+  stream.name = "loop";
+  UINT32 seed = 0x12345678;
+  while (stream.records.size() < n) {
+    // an outer loop around an inner loop with a data dependent branch
+    UINT32 loop = Xorshift(&seed) % 64;
+    UINT32 PC = 0x500000 + loop * 64;
+    unsigned outerTrips = 3 + loop % 8;
+    unsigned innerTrips = 3 + (loop * 7) % 62;
+    for (unsigned o = 0; o < outerTrips; o++) {
+      for (unsigned k = 0; k < innerTrips; k++) {
+        stream.records.push_back(CondBranch(PC + 4, (Xorshift(&seed) & 3) != 0));
+        stream.records.push_back(CondBranch(PC + 8, k + 1 < innerTrips));
+      }
+      stream.records.push_back(CondBranch(PC + 12, o + 1 < outerTrips));
+    }
+  }
+  stream.records.resize(n);
+  Finish(&stream);
+  return stream;
+}
+
+static bool TraceStream(char *trace, size_t n, BenchStream *stream) {
+  TraceSource *src = OpenTrace(trace);
+  if (src == NULL) {
+    return false;
+  }
+  const char *base = strrchr(trace, '/');
+  stream->name = base ? base + 1 : trace;
+  stream->records.resize(n);
+  size_t count = 0;
+  size_t got;
+  while (count < n && (got = src->Next(&stream->records[count], std::min((size_t)BRANCH_CHUNK_SIZE, n - count))) > 0) {
+    count += got;
+  }
+  stream->records.resize(count);
+  delete src;
+  Finish(stream);
+  return true;
+}
+
+/////////////////////////////////////////////////////////////
+// timing
+/////////////////////////////////////////////////////////////
+
+// one run over the stream, returns mispredictions
+static UINT64 RunStream(const PredictorDesc &pred, const BenchStream &stream) {
+  UINT64 numMispred = 0;
+  const BranchRecord *recs = &stream.records[0];
+  for (size_t i = 0; i < stream.records.size(); i++) {
+    const BranchRecord &rec = recs[i];
+    if (rec.opType != OPTYPE_BRANCH_COND) {
+      continue;
+    }
+    bool predDir = pred.Get(rec.PC);
+    pred.Update(rec.PC, rec.taken, predDir, rec.branchTarget);
+    numMispred += (predDir != rec.taken);
+  }
+  return numMispred;
+}
+
+static void Bench(const PredictorDesc &pred, const BenchStream &stream, unsigned warmup, unsigned runs) {
+  if (stream.numCondBr == 0) {
+    return;
+  }
+  UINT64 numMispred = 0;
+  for (unsigned w = 0; w < warmup; w++) {
+    pred.Init();
+    numMispred = RunStream(pred, stream);
+  }
+
+  std::vector<double> ns;
+  for (unsigned r = 0; r < runs; r++) {
+    pred.Init();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    numMispred = RunStream(pred, stream);
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    ns.push_back(std::chrono::duration<double, std::nano>(end - start).count() / (double)stream.numCondBr);
+  }
+
+  std::sort(ns.begin(), ns.end());
+  double median = ns.size() % 2 ? ns[ns.size() / 2] : 0.5 * (ns[ns.size() / 2 - 1] + ns[ns.size() / 2]);
+  double mean = 0.0;
+  for (size_t r = 0; r < ns.size(); r++) {
+    mean += ns[r];
+  }
+  mean /= ns.size();
+  double var = 0.0;
+  for (size_t r = 0; r < ns.size(); r++) {
+    var += (ns[r] - mean) * (ns[r] - mean);
+  }
+  double stddev = ns.size() > 1 ? sqrt(var / (ns.size() - 1)) : 0.0;
+
+  printf("%-28s %-16s %10.2f %10.2f %8.2f %10.2f %8.2f%%\n", pred.name, stream.name.c_str(), median, mean, stddev,
+         ns[0], 100.0 * (double)numMispred / (double)stream.numCondBr);
+  fflush(stdout);
+}
+
+/////////////////////////////////////////////////////////////
+// driver
+/////////////////////////////////////////////////////////////
+
+static void Usage(char *prog) {
+  fprintf(stderr, "usage: %s [-g] [-n records] [-w warmup] [-r runs] [-c cpu] [-p name[,name...]] [<trace> ...]\n",
+          prog);
+  exit(-1);
+}
+
+static bool PinToCpu(int cpu) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
+
+int main(int argc, char *argv[]) {
+  RegisterDefaultPredictors();
+
+  size_t numRecords = BENCH_DEFAULT_RECORDS;
+  unsigned warmup = BENCH_DEFAULT_WARMUP;
+  unsigned runs = BENCH_DEFAULT_RUNS;
+  std::vector<int> selected;
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; i++) {
+    if (strcmp(argv[i], "-g") == 0) {
+      RegisterPredictorGrid();
+    }
+    else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      numRecords = strtoull(argv[++i], NULL, 10);
+    }
+    else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+      warmup = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+      runs = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      if (!PinToCpu(atoi(argv[++i]))) {
+        fprintf(stderr, "bpbench: cannot pin to cpu %s\n", argv[i]);
+        exit(-1);
+      }
+    }
+    else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+      for (char *name = strtok(argv[++i], ","); name != NULL; name = strtok(NULL, ",")) {
+        int idx = FindPredictor(name);
+        if (idx < 0) {
+          fprintf(stderr, "bpbench: unknown predictor %s\n", name);
+          Usage(argv[0]);
+        }
+        selected.push_back(idx);
+      }
+    }
+    else {
+      Usage(argv[0]);
+    }
+  }
+  if (runs == 0 || numRecords == 0) {
+    Usage(argv[0]);
+  }
+
+  std::vector<BenchStream> streams;
+  streams.push_back(RandomStream(numRecords));
+  streams.push_back(BiasedStream(numRecords));
+  streams.push_back(LoopStream(numRecords));
+  for (; i < argc; i++) {
+    streams.push_back(BenchStream());
+    if (!TraceStream(argv[i], numRecords, &streams.back())) {
+      fprintf(stderr, "bpbench: cannot open trace %s\n", argv[i]);
+      exit(-1);
+    }
+  }
+
+  // every predictor runs alone, so names sharing tables need no check
+  if (selected.empty()) {
+    for (size_t p = 0; p < PredictorRegistry().size(); p++) {
+      selected.push_back((int)p);
+    }
+  }
+
+  printf("%-28s %-16s %10s %10s %8s %10s %9s\n", "predictor", "stream", "median ns", "mean ns", "stddev", "min ns",
+         "mispred");
+  for (size_t p = 0; p < selected.size(); p++) {
+    for (size_t s = 0; s < streams.size(); s++) {
+      Bench(PredictorRegistry()[selected[p]], streams[s], warmup, runs);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bpsim.h"
+#include "bptrace.h"
+
+/////////////////////////////////////////////////////////////
+// trace converter
+/////////////////////////////////////////////////////////////
+/*
+Converts a CBP trace to the compact .bpt format of bptrace.h.
+The result is read by fanout (and every other tool using OpenTrace)
+in place of the original trace.
+
+usage: bpconvert <trace> <output.bpt>
+*/
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s <trace> <output.bpt>\n", argv[0]);
+    exit(-1);
+  }
+
+  TraceSource *src = OpenTrace(argv[1]);
+  if (src == NULL) {
+    fprintf(stderr, "bpconvert: cannot open trace %s\n", argv[1]);
+    exit(-1);
+  }
+
+  BpTraceWriter writer;
+  if (!writer.Open(argv[2])) {
+    fprintf(stderr, "bpconvert: cannot create %s\n", argv[2]);
+    exit(-1);
+  }
+
+  BranchRecord chunk[BRANCH_CHUNK_SIZE];
+  size_t count;
+  UINT64 numRecords = 0;
+  UINT64 numInsts = 0;
+  while ((count = src->Next(chunk, BRANCH_CHUNK_SIZE)) > 0) {
+    for (size_t i = 0; i < count; i++) {
+      writer.Append(chunk[i]);
+      numInsts += chunk[i].instGap;
+    }
+    numRecords += count;
+  }
+  delete src;
+
+  if (!writer.Close()) {
+    fprintf(stderr, "bpconvert: error writing %s\n", argv[2]);
+    exit(-1);
+  }
+
+  printf("%s: %llu records, %llu instructions\n", argv[2],
+         (unsigned long long)numRecords, (unsigned long long)numInsts);
+  return 0;
+}
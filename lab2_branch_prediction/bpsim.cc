@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <utility>
+
+#include "bpsim.h"
+#include "bptrace.h"
+#include "hybrid.h"
+#include "loop.h"
+#include "tracer.h"
+#include "predictor.h"
+
+/////////////////////////////////////////////////////////////
+// CBP trace source
+/////////////////////////////////////////////////////////////
+
+class CbpTraceSource : public TraceSource {
+ public:
+  CbpTraceSource(char *traceName) : reader(traceName), pendingInsts(0), done(false) {}
+
+  size_t Next(BranchRecord *buf, size_t max) {
+    size_t count = 0;
+    OpType opType;
+    UINT32 PC;
+    bool branchTaken;
+    UINT32 branchTarget;
+
+    while (!done && count < max) {
+      if (!reader.GetNextRecord(&PC, &opType, &branchTaken, &branchTarget)) {
+        done = true;
+        break;
+      }
+      pendingInsts++;
+
+      // non-branch instructions are only counted
+      if (opType == OPTYPE_OP) {
+        continue;
+      }
+
+      BranchRecord &rec = buf[count++];
+      rec.PC = PC;
+      rec.branchTarget = branchTarget;
+      rec.instGap = pendingInsts;
+      rec.opType = opType;
+      rec.taken = branchTaken;
+      pendingInsts = 0;
+    }
+
+    // flush the instructions after the last branch
+    if (done && pendingInsts > 0 && count < max) {
+      BranchRecord &rec = buf[count++];
+      memset(&rec, 0, sizeof(rec));
+      rec.instGap = pendingInsts;
+      rec.opType = OPTYPE_OP;
+      pendingInsts = 0;
+    }
+    return count;
+  }
+
+ private:
+  CBP_TRACE_READER reader;
+  UINT32 pendingInsts;
+  bool done;
+};
+
+TraceSource *OpenTrace(char *traceName) {
+  FILE *f = fopen(traceName, "rb");
+  if (f == NULL) {
+    return NULL;
+  }
+  fclose(f);
+
+  // traces converted by bpconvert are replayed from the mapped file
+  if (IsBpTrace(traceName)) {
+    return OpenBpTrace(traceName);
+  }
+
+  return new CbpTraceSource(traceName);
+}
+
+/////////////////////////////////////////////////////////////
+// predictor registry
+/////////////////////////////////////////////////////////////
+
+std::vector<PredictorDesc> &PredictorRegistry() {
+  static std::vector<PredictorDesc> registry;
+  return registry;
+}
+
+PredictorDesc &RegisterPredictor(const char *name, void (*init)(), bool (*get)(UINT32),
+                                 void (*update)(UINT32, bool, bool, UINT32), UINT64 storageBits) {
+  PredictorDesc desc;
+  desc.name = name;
+  desc.storageBits = storageBits;
+  desc.Init = init;
+  desc.Get = get;
+  desc.Update = update;
+  desc.stateId = init;
+  desc.Report = NULL;
+  desc.Save = NULL;
+  desc.Restore = NULL;
+  desc.PipePredict = NULL;
+  desc.PipeRepair = NULL;
+  desc.PipeCommit = NULL;
+  desc.stateSize = 0;
+  desc.stateAlign = 0;
+  desc.InitAt = NULL;
+  desc.GetAt = NULL;
+  desc.UpdateAt = NULL;
+  desc.PipePredictAt = NULL;
+  desc.PipeRepairAt = NULL;
+  desc.PipeCommitAt = NULL;
+  PredictorRegistry().push_back(desc);
+  return PredictorRegistry().back();
+}
+
+// the wrappers of predictor.cc drive the tables of their Predictor_ template
+#define REGISTER_DEFAULT(name)                                                         \
+  SetTemplateHooks<Predictor_##name>(RegisterPredictor(#name, InitPredictor_##name,       \
+                                                       GetPrediction_##name,              \
+                                                       UpdatePredictor_##name,            \
+                                                       Predictor_##name::kStorageBits))
+
+void RegisterDefaultPredictors() {
+  REGISTER_DEFAULT(2bitsat);
+  REGISTER_DEFAULT(2level);
+  REGISTER_DEFAULT(openend);
+  REGISTER_DEFAULT(pshare);
+  REGISTER_DEFAULT(tage);
+  REGISTER_DEFAULT(perceptron);
+  REGISTER_DEFAULT(hperceptron);
+}
+
+int FindPredictor(const char *name) {
+  std::vector<PredictorDesc> &registry = PredictorRegistry();
+  for (size_t i = 0; i < registry.size(); i++) {
+    if (strcmp(registry[i].name, name) == 0) {
+      return (int)i;
+    }
+  }
+
+  // hybrid:a+b... and loop:a specs are composed on first use
+  if (strncmp(name, "hybrid:", 7) == 0) {
+    return RegisterHybrid(name);
+  }
+  if (strncmp(name, "loop:", 5) == 0) {
+    return RegisterLoop(name);
+  }
+  return -1;
+}
+
+// idx and everything it drives
+static void CollectPredictorTables(int idx, std::vector<int> *uses) {
+  uses->push_back(idx);
+  const std::vector<int> &parts = PredictorRegistry()[idx].parts;
+  for (size_t p = 0; p < parts.size(); p++) {
+    CollectPredictorTables(parts[p], uses);
+  }
+}
+
+bool CheckPredictorConflicts(const std::vector<int> &selected, bool report) {
+  std::vector<PredictorDesc> &registry = PredictorRegistry();
+  std::vector<std::pair<void (*)(), int> > owner;
+
+  for (size_t i = 0; i < selected.size(); i++) {
+    std::vector<int> uses;
+    CollectPredictorTables(selected[i], &uses);
+
+    for (size_t u = 0; u < uses.size(); u++) {
+      for (size_t k = 0; k < owner.size(); k++) {
+        if (owner[k].first == registry[uses[u]].stateId) {
+          if (report) {
+            fprintf(stderr, "%s and %s use the same tables\n", registry[owner[k].second].name,
+                    registry[selected[i]].name);
+          }
+          return false;
+        }
+      }
+      owner.push_back(std::make_pair(registry[uses[u]].stateId, selected[i]));
+    }
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////////////////
+// checkpoint files
+/////////////////////////////////////////////////////////////
+/*
+  "BPS1"  magic
+  UINT32  length of the predictor name, then the name
+  UINT64  length of the state, then the state
+*/
+
+bool SavePredictorFile(const PredictorDesc &pred, const char *path) {
+  if (pred.Save == NULL) {
+    fprintf(stderr, "%s: no checkpoint support\n", pred.name);
+    return false;
+  }
+
+  PredictorState state;
+  pred.Save(&state);
+
+  FILE *f = fopen(path, "wb");
+  if (f == NULL) {
+    fprintf(stderr, "cannot write %s\n", path);
+    return false;
+  }
+  UINT32 nameLen = strlen(pred.name);
+  UINT64 stateLen = state.size();
+  bool ok = fwrite("BPS1", 1, 4, f) == 4 && fwrite(&nameLen, sizeof(nameLen), 1, f) == 1 &&
+            fwrite(pred.name, 1, nameLen, f) == nameLen && fwrite(&stateLen, sizeof(stateLen), 1, f) == 1 &&
+            fwrite(state.data(), 1, state.size(), f) == state.size();
+  ok = (fclose(f) == 0) && ok;
+  if (!ok) {
+    fprintf(stderr, "cannot write %s\n", path);
+  }
+  return ok;
+}
+
+bool LoadPredictorFile(const PredictorDesc &pred, const char *path) {
+  if (pred.Restore == NULL) {
+    fprintf(stderr, "%s: no checkpoint support\n", pred.name);
+    return false;
+  }
+
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    fprintf(stderr, "cannot read %s\n", path);
+    return false;
+  }
+
+  // a checkpoint of this predictor is as long as its own Save() output
+  PredictorState expected;
+  pred.Save(&expected);
+
+  char magic[4];
+  UINT32 nameLen = 0;
+  UINT64 stateLen = 0;
+  std::string name;
+  PredictorState state;
+  bool ok = fread(magic, 1, 4, f) == 4 && memcmp(magic, "BPS1", 4) == 0 &&
+            fread(&nameLen, sizeof(nameLen), 1, f) == 1 && nameLen < 4096;
+  if (ok) {
+    name.resize(nameLen);
+    ok = (nameLen == 0 || fread(&name[0], 1, nameLen, f) == nameLen) && fread(&stateLen, sizeof(stateLen), 1, f) == 1;
+  }
+  bool sizeOk = ok && name == pred.name && stateLen == expected.size();
+  if (sizeOk) {
+    state.resize(stateLen);
+    ok = stateLen == 0 || fread(&state[0], 1, stateLen, f) == stateLen;
+  }
+  fclose(f);
+
+  if (!ok) {
+    fprintf(stderr, "%s is not a predictor checkpoint\n", path);
+    return false;
+  }
+  if (name != pred.name) {
+    fprintf(stderr, "%s holds %s, not %s\n", path, name.c_str(), pred.name);
+    return false;
+  }
+  if (!sizeOk || !pred.Restore(state)) {
+    fprintf(stderr, "%s does not match the tables of %s\n", path, pred.name);
+    return false;
+  }
+  return true;
+}
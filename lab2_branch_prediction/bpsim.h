@@ -0,0 +1,191 @@
+#ifndef _BPSIM_H_
+#define _BPSIM_H_
+
+#include <string>
+#include <vector>
+
+#include "utils.h"
+#include "predictor_state.h"
+
+/////////////////////////////////////////////////////////////
+// decoded branch records
+/////////////////////////////////////////////////////////////
+/*
+A trace is decoded once into BranchRecords and every record is
+handed to all registered predictors.
+Non-branch instructions are not kept, instead each record carries
+the number of instructions retired since the previous record
+(including itself) so MPKI can still be computed.
+Instructions after the last branch of a trace are flushed as a
+final record with opType OPTYPE_OP.
+*/
+
+struct BranchRecord {
+  UINT32 PC;
+  UINT32 branchTarget;
+  UINT32 instGap;
+  uint8_t opType;
+  bool taken;
+};
+
+// number of records decoded before they are fanned out to the predictors
+#define BRANCH_CHUNK_SIZE 4096
+
+class TraceSource {
+ public:
+  virtual ~TraceSource() {}
+
+  // fills buf with up to max records, returns 0 at the end of the trace
+  virtual size_t Next(BranchRecord *buf, size_t max) = 0;
+};
+
+// opens a CBP trace or a .bpt file written by bpconvert,
+// returns NULL if it cannot be read
+TraceSource *OpenTrace(char *traceName);
+
+/////////////////////////////////////////////////////////////
+// predictor registry
+/////////////////////////////////////////////////////////////
+/*
+Every predictor is a set of Init/Get/Update functions with the same
+signatures as the ones in predictor.h.
+Predictor state is thread_local, so each worker thread of the driver
+owns a private copy of every registered predictor.
+Several names can drive the same tables (a predictor.h wrapper and the
+equal grid point, or a shadow of alias.h). stateId tells them apart:
+predictors with the same stateId must not run in the same pass.
+Templates can also run on a caller-owned copy of their tables
+(InitAt/GetAt/UpdateAt), which is how a hybrid keeps its components
+apart from their plain registrations.
+*/
+
+struct PredictorDesc {
+  const char *name;
+  UINT64 storageBits;
+  void (*Init)();
+  bool (*Get)(UINT32 PC);
+  void (*Update)(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget);
+
+  // Init of the template that owns the tables, Init itself by default
+  void (*stateId)();
+  // optional statistics of the current thread's run, printed after the MPKI
+  std::string (*Report)();
+
+  // checkpoint of the current thread's tables (NULL if not supported)
+  void (*Save)(PredictorState *out);
+  bool (*Restore)(const PredictorState &in);
+
+  // registry indices of the predictors whose tables this one drives (loop
+  // base, hybrid components without InitAt, ...)
+  std::vector<int> parts;
+
+  // split Get/Update for delayed updates (NULL if not supported, see pipeline.h)
+  bool (*PipePredict)(UINT32 PC, InFlightBranch *b, bool spec);
+  void (*PipeRepair)(const InFlightBranch &b, bool resolveDir);
+  void (*PipeCommit)(const InFlightBranch &b, bool resolveDir, bool spec);
+
+  // the same predictor on stateSize bytes owned by the caller, aligned to
+  // stateAlign and made of plain arrays (NULL if not supported)
+  size_t stateSize;
+  size_t stateAlign;
+  void (*InitAt)(void *state);
+  bool (*GetAt)(void *state, UINT32 PC);
+  void (*UpdateAt)(void *state, UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget);
+  bool (*PipePredictAt)(void *state, UINT32 PC, InFlightBranch *b, bool spec);
+  void (*PipeRepairAt)(void *state, const InFlightBranch &b, bool resolveDir);
+  void (*PipeCommitAt)(void *state, const InFlightBranch &b, bool resolveDir, bool spec);
+};
+
+std::vector<PredictorDesc> &PredictorRegistry();
+
+PredictorDesc &RegisterPredictor(const char *name, void (*init)(), bool (*get)(UINT32),
+                                 void (*update)(UINT32, bool, bool, UINT32), UINT64 storageBits = 0);
+
+// Init/Get/Update and the pipeline hooks of P on a caller-owned P::State
+template <class P>
+struct StateHooks {
+  typedef typename P::State State;
+
+  static void Init(void *s) { P::Init(*(State *)s); }
+  static bool Get(void *s, UINT32 PC) { return P::Get(*(State *)s, PC); }
+  static void Update(void *s, UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
+    P::Update(*(State *)s, PC, resolveDir, predDir, branchTarget);
+  }
+  static bool PipePredict(void *s, UINT32 PC, InFlightBranch *b, bool spec) {
+    return P::PipePredict(*(State *)s, PC, b, spec);
+  }
+  static void PipeRepair(void *s, const InFlightBranch &b, bool resolveDir) { P::PipeRepair(*(State *)s, b, resolveDir); }
+  static void PipeCommit(void *s, const InFlightBranch &b, bool resolveDir, bool spec) {
+    P::PipeCommit(*(State *)s, b, resolveDir, spec);
+  }
+};
+
+// PipePredict/PipeRepair/PipeCommit of P if it has them
+template <class P>
+struct PipelineHooks {
+  template <class U>
+  static char Test(decltype(U::PipePredict((UINT32)0, (InFlightBranch *)0, false)) *);
+  template <class U>
+  static long Test(...);
+  static const bool kHas = sizeof(Test<P>(0)) == 1;
+
+  template <class U, bool Has>
+  struct Set {
+    static void To(PredictorDesc &desc) {
+      desc.PipePredict = U::PipePredict;
+      desc.PipeRepair = U::PipeRepair;
+      desc.PipeCommit = U::PipeCommit;
+      desc.PipePredictAt = StateHooks<U>::PipePredict;
+      desc.PipeRepairAt = StateHooks<U>::PipeRepair;
+      desc.PipeCommitAt = StateHooks<U>::PipeCommit;
+    }
+  };
+  template <class U>
+  struct Set<U, false> {
+    static void To(PredictorDesc &desc) {}
+  };
+};
+
+// hooks every template has, for desc driving the tables of P
+template <class P>
+void SetTemplateHooks(PredictorDesc &desc) {
+  desc.stateId = P::Init;
+  desc.Save = P::Save;
+  desc.Restore = P::Restore;
+  PipelineHooks<P>::template Set<P, PipelineHooks<P>::kHas>::To(desc);
+  desc.stateSize = sizeof(typename P::State);
+  desc.stateAlign = alignof(typename P::State);
+  desc.InitAt = StateHooks<P>::Init;
+  desc.GetAt = StateHooks<P>::Get;
+  desc.UpdateAt = StateHooks<P>::Update;
+}
+
+// registers one of the templates in predictor_templates.h
+template <class P>
+PredictorDesc &RegisterTemplate(const char *name) {
+  PredictorDesc &desc = RegisterPredictor(name, P::Init, P::Get, P::Update, P::kStorageBits);
+  SetTemplateHooks<P>(desc);
+  return desc;
+}
+
+// writes / reads the checkpoint of pred for the current thread,
+// false (and a message on stderr) on an I/O error or a mismatch
+bool SavePredictorFile(const PredictorDesc &pred, const char *path);
+bool LoadPredictorFile(const PredictorDesc &pred, const char *path);
+
+// false if two of the selected predictors or their parts share tables
+// (same stateId), with a message on stderr if report is set; parts run on
+// caller-owned state are not listed and never conflict
+bool CheckPredictorConflicts(const std::vector<int> &selected, bool report = true);
+
+// registers the predictors of predictor.h
+void RegisterDefaultPredictors();
+
+// registers the budget sweep of predictor_grid.cc
+void RegisterPredictorGrid();
+
+// returns the index of the predictor called name, or -1
+// (hybrid:... and loop:... names are registered on first use, see hybrid.h and loop.h)
+int FindPredictor(const char *name);
+
+#endif
@@ -0,0 +1,323 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bptrace.h"
+
+/////////////////////////////////////////////////////////////
+// field encoding
+/////////////////////////////////////////////////////////////
+
+static inline UINT32 ZigZag(INT32 v) {
+  return ((UINT32)v << 1) ^ (UINT32)(v >> 31);
+}
+
+static inline INT32 UnZigZag(UINT32 v) {
+  return (INT32)(v >> 1) ^ -(INT32)(v & 0x1);
+}
+
+// smallest of 1, 2 or 4 bytes that holds v
+static inline uint8_t FieldWidth(UINT32 v) {
+  if (v <= 0xFF) {
+    return 1;
+  }
+  if (v <= 0xFFFF) {
+    return 2;
+  }
+  return 4;
+}
+
+static inline UINT32 LoadField(const uint8_t *p, uint8_t width) {
+  switch (width) {
+    case 1:
+      return *p;
+    case 2: {
+      uint16_t v;
+      memcpy(&v, p, sizeof(v));
+      return v;
+    }
+    default: {
+      UINT32 v;
+      memcpy(&v, p, sizeof(v));
+      return v;
+    }
+  }
+}
+
+// offsets of the field arrays inside a block
+struct BlockLayout {
+  size_t opType;
+  size_t pcDelta;
+  size_t targetDelta;
+  size_t instGap;
+  size_t size;
+
+  BlockLayout(const BpTraceBlock &blk) {
+    UINT32 n = blk.numRecords;
+    opType = ((n + 63) / 64) * sizeof(uint64_t);
+    pcDelta = opType + n;
+    targetDelta = pcDelta + (size_t)n * blk.pcWidth;
+    instGap = targetDelta + (size_t)n * blk.targetWidth;
+    size = instGap + (size_t)n * blk.gapWidth;
+  }
+};
+
+/////////////////////////////////////////////////////////////
+// writer
+/////////////////////////////////////////////////////////////
+
+BpTraceWriter::BpTraceWriter() : file(NULL), ok(false), lastPC(0) {}
+
+BpTraceWriter::~BpTraceWriter() {
+  if (file != NULL) {
+    fclose(file);
+  }
+}
+
+bool BpTraceWriter::Open(const char *fileName) {
+  file = fopen(fileName, "wb");
+  if (file == NULL) {
+    return false;
+  }
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, BPT_MAGIC, sizeof(header.magic));
+  header.version = BPT_VERSION;
+  header.blockRecords = BPT_BLOCK_RECORDS;
+
+  // placeholder, rewritten by Close()
+  ok = fwrite(&header, sizeof(header), 1, file) == 1;
+  index.clear();
+  block.clear();
+  block.reserve(BPT_BLOCK_RECORDS);
+  lastPC = 0;
+  return ok;
+}
+
+void BpTraceWriter::Append(const BranchRecord &rec) {
+  block.push_back(rec);
+  if (block.size() == BPT_BLOCK_RECORDS) {
+    FlushBlock();
+  }
+}
+
+void BpTraceWriter::FlushBlock() {
+  if (block.empty()) {
+    return;
+  }
+
+  UINT32 n = block.size();
+  BpTraceBlock blk;
+  memset(&blk, 0, sizeof(blk));
+  blk.offset = ftell(file);
+  blk.firstInst = header.numInsts;
+  blk.numRecords = n;
+  blk.basePC = lastPC;
+
+  // encode the deltas and pick the field widths
+  std::vector<UINT32> pcDelta(n), targetDelta(n), instGap(n);
+  UINT32 maxPc = 0, maxTarget = 0, maxGap = 0;
+  UINT32 prevPC = lastPC;
+  for (UINT32 i = 0; i < n; i++) {
+    const BranchRecord &rec = block[i];
+    pcDelta[i] = ZigZag((INT32)(rec.PC - prevPC));
+    targetDelta[i] = ZigZag((INT32)(rec.branchTarget - rec.PC));
+    instGap[i] = rec.instGap;
+    prevPC = rec.PC;
+
+    maxPc |= pcDelta[i];
+    maxTarget |= targetDelta[i];
+    maxGap |= instGap[i];
+    header.numInsts += rec.instGap;
+  }
+  blk.pcWidth = FieldWidth(maxPc);
+  blk.targetWidth = FieldWidth(maxTarget);
+  blk.gapWidth = FieldWidth(maxGap);
+
+  BlockLayout layout(blk);
+  std::vector<uint8_t> data(layout.size, 0);
+  for (UINT32 i = 0; i < n; i++) {
+    uint64_t bit = (uint64_t)(block[i].taken ? 1 : 0) << (i % 64);
+    uint64_t word;
+    memcpy(&word, &data[(i / 64) * sizeof(uint64_t)], sizeof(word));
+    word |= bit;
+    memcpy(&data[(i / 64) * sizeof(uint64_t)], &word, sizeof(word));
+
+    data[layout.opType + i] = block[i].opType;
+    memcpy(&data[layout.pcDelta + (size_t)i * blk.pcWidth], &pcDelta[i], blk.pcWidth);
+    memcpy(&data[layout.targetDelta + (size_t)i * blk.targetWidth], &targetDelta[i], blk.targetWidth);
+    memcpy(&data[layout.instGap + (size_t)i * blk.gapWidth], &instGap[i], blk.gapWidth);
+  }
+
+  if (fwrite(&data[0], data.size(), 1, file) != 1) {
+    ok = false;
+  }
+
+  index.push_back(blk);
+  header.numRecords += n;
+  lastPC = prevPC;
+  block.clear();
+}
+
+bool BpTraceWriter::Close() {
+  if (file == NULL) {
+    return false;
+  }
+
+  FlushBlock();
+
+  // the index is read in place, align it for its UINT64 fields
+  static const uint8_t pad[sizeof(UINT64)] = {0};
+  long end = ftell(file);
+  size_t padding = (sizeof(UINT64) - end % sizeof(UINT64)) % sizeof(UINT64);
+  if (padding > 0 && fwrite(pad, padding, 1, file) != 1) {
+    ok = false;
+  }
+
+  header.numBlocks = index.size();
+  header.indexOffset = end + padding;
+  if (!index.empty() && fwrite(&index[0], sizeof(BpTraceBlock), index.size(), file) != index.size()) {
+    ok = false;
+  }
+
+  if (fseek(file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file) != 1) {
+    ok = false;
+  }
+  if (fclose(file) != 0) {
+    ok = false;
+  }
+  file = NULL;
+  return ok;
+}
+
+/////////////////////////////////////////////////////////////
+// reader
+/////////////////////////////////////////////////////////////
+
+BpTraceReader::BpTraceReader() : base(NULL), length(0), header(NULL), blocks(NULL) {}
+
+BpTraceReader::~BpTraceReader() {
+  if (base != NULL) {
+    munmap((void *)base, length);
+  }
+}
+
+bool BpTraceReader::Open(const char *fileName) {
+  int fd = open(fileName, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(BpTraceHeader)) {
+    close(fd);
+    return false;
+  }
+
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  base = (const uint8_t *)map;
+  length = st.st_size;
+  madvise(map, length, MADV_SEQUENTIAL);
+
+  header = (const BpTraceHeader *)base;
+  if (memcmp(header->magic, BPT_MAGIC, sizeof(header->magic)) != 0 || header->version != BPT_VERSION ||
+      header->indexOffset % sizeof(UINT64) != 0 ||
+      header->indexOffset + (UINT64)header->numBlocks * sizeof(BpTraceBlock) > length) {
+    return false;
+  }
+  blocks = (const BpTraceBlock *)(base + header->indexOffset);
+
+  for (UINT32 b = 0; b < header->numBlocks; b++) {
+    if (blocks[b].offset + BlockLayout(blocks[b]).size > header->indexOffset) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void BpTraceReader::Decode(UINT32 b, UINT32 first, UINT32 count, UINT32 *PC, BranchRecord *out) const {
+  const BpTraceBlock &blk = blocks[b];
+  BlockLayout layout(blk);
+  const uint8_t *data = base + blk.offset;
+
+  const uint8_t *opType = data + layout.opType;
+  const uint8_t *pcDelta = data + layout.pcDelta;
+  const uint8_t *targetDelta = data + layout.targetDelta;
+  const uint8_t *instGap = data + layout.instGap;
+
+  UINT32 pc = first == 0 ? blk.basePC : *PC;
+  for (UINT32 i = first; i < first + count; i++) {
+    uint64_t takenWord;
+    memcpy(&takenWord, data + (i / 64) * sizeof(uint64_t), sizeof(takenWord));
+
+    pc += UnZigZag(LoadField(pcDelta + (size_t)i * blk.pcWidth, blk.pcWidth));
+
+    BranchRecord &rec = *out++;
+    rec.PC = pc;
+    rec.branchTarget = pc + UnZigZag(LoadField(targetDelta + (size_t)i * blk.targetWidth, blk.targetWidth));
+    rec.instGap = LoadField(instGap + (size_t)i * blk.gapWidth, blk.gapWidth);
+    rec.opType = opType[i];
+    rec.taken = (takenWord >> (i % 64)) & 0x1;
+  }
+  *PC = pc;
+}
+
+bool IsBpTrace(const char *fileName) {
+  FILE *f = fopen(fileName, "rb");
+  if (f == NULL) {
+    return false;
+  }
+  char magic[4];
+  bool match = fread(magic, sizeof(magic), 1, f) == 1 && memcmp(magic, BPT_MAGIC, sizeof(magic)) == 0;
+  fclose(f);
+  return match;
+}
+
+/////////////////////////////////////////////////////////////
+// trace source
+/////////////////////////////////////////////////////////////
+
+class BpTraceSource : public TraceSource {
+ public:
+  BpTraceSource() : block(0), pos(0), PC(0) {}
+
+  bool Open(const char *fileName) { return reader.Open(fileName); }
+
+  size_t Next(BranchRecord *buf, size_t max) {
+    size_t count = 0;
+    while (count < max && block < reader.NumBlocks()) {
+      UINT32 left = reader.Block(block).numRecords - pos;
+      UINT32 n = left < max - count ? left : max - count;
+
+      reader.Decode(block, pos, n, &PC, buf + count);
+      count += n;
+      pos += n;
+      if (pos == reader.Block(block).numRecords) {
+        block++;
+        pos = 0;
+      }
+    }
+    return count;
+  }
+
+ private:
+  BpTraceReader reader;
+  UINT32 block;
+  UINT32 pos;
+  UINT32 PC;
+};
+
+TraceSource *OpenBpTrace(const char *fileName) {
+  BpTraceSource *src = new BpTraceSource();
+  if (!src->Open(fileName)) {
+    delete src;
+    return NULL;
+  }
+  return src;
+}
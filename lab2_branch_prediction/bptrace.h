@@ -0,0 +1,121 @@
+#ifndef _BPTRACE_H_
+#define _BPTRACE_H_
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "bpsim.h"
+
+/////////////////////////////////////////////////////////////
+// compact branch trace format (.bpt)
+/////////////////////////////////////////////////////////////
+/*
+A .bpt file holds the BranchRecords of one trace, written once by
+bpconvert and replayed by mmap-ing the file.
+
+  BpTraceHeader
+  block 0 data
+  block 1 data
+  ...
+  padding to 8 bytes
+  BpTraceBlock[numBlocks]   (block index, at indexOffset)
+
+Records are grouped in blocks of BPT_BLOCK_RECORDS. Inside a block the
+fields are stored as separate arrays:
+
+  uint64_t taken[(n + 63) / 64]    direction bits, record i is bit i % 64
+  uint8_t  opType[n]
+  pcDelta[n]                       zigzag(PC - previous PC), pcWidth bytes
+  targetDelta[n]                   zigzag(branchTarget - PC), targetWidth bytes
+  instGap[n]                       gapWidth bytes
+
+Each block picks the smallest of 1, 2 or 4 bytes for its delta arrays,
+the first PC delta of a block is relative to basePC.
+Everything is in host byte order. indexOffset is a multiple of 8, so
+the index is read in place from the mapping.
+
+Replay decodes each block into a chunk of BranchRecords, so the
+predictors keep their record interface; only the index is used
+without a copy.
+*/
+
+#define BPT_MAGIC "BPT1"
+#define BPT_VERSION 1
+#define BPT_BLOCK_RECORDS 4096
+
+struct BpTraceHeader {
+  char magic[4];
+  UINT32 version;
+  UINT64 numRecords;
+  UINT64 numInsts;
+  UINT32 blockRecords;
+  UINT32 numBlocks;
+  UINT64 indexOffset;
+};
+
+struct BpTraceBlock {
+  UINT64 offset;     // file offset of the block data
+  UINT64 firstInst;  // instructions retired before the block
+  UINT32 numRecords;
+  UINT32 basePC;
+  uint8_t pcWidth;
+  uint8_t targetWidth;
+  uint8_t gapWidth;
+  uint8_t pad[5];
+};
+
+// writes a .bpt file one record at a time
+class BpTraceWriter {
+ public:
+  BpTraceWriter();
+  ~BpTraceWriter();
+
+  bool Open(const char *fileName);
+  void Append(const BranchRecord &rec);
+  // flushes the last block and writes the block index, returns false on I/O errors
+  bool Close();
+
+ private:
+  void FlushBlock();
+
+  FILE *file;
+  bool ok;
+  BpTraceHeader header;
+  std::vector<BpTraceBlock> index;
+  std::vector<BranchRecord> block;
+  UINT32 lastPC;
+};
+
+// read-only view of a mmap-ed .bpt file
+class BpTraceReader {
+ public:
+  BpTraceReader();
+  ~BpTraceReader();
+
+  // returns false if the file cannot be mapped or is not a .bpt file
+  bool Open(const char *fileName);
+
+  const BpTraceHeader &Header() const { return *header; }
+  UINT32 NumBlocks() const { return header->numBlocks; }
+  const BpTraceBlock &Block(UINT32 b) const { return blocks[b]; }
+
+  // decodes records [first, first + count) of block b into out,
+  // PC holds the PC of record first - 1 on entry (ignored when first is 0)
+  // and the PC of the last decoded record on return
+  void Decode(UINT32 b, UINT32 first, UINT32 count, UINT32 *PC, BranchRecord *out) const;
+
+ private:
+  const uint8_t *base;
+  size_t length;
+  const BpTraceHeader *header;
+  const BpTraceBlock *blocks;
+};
+
+// true if fileName starts with BPT_MAGIC
+bool IsBpTrace(const char *fileName);
+
+// TraceSource replaying a .bpt file, returns NULL on errors
+TraceSource *OpenBpTrace(const char *fileName);
+
+#endif
@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "confidence.h"
+
+/////////////////////////////////////////////////////////////
+// configuration
+/////////////////////////////////////////////////////////////
+
+bool ParseConfidenceConfig(const char *spec, ConfidenceConfig *cfg) {
+  cfg->ctrBits = 4;
+  cfg->threshold = 15;
+
+  char *end;
+  cfg->logEntries = strtoul(spec, &end, 10);
+  if (end == spec) {
+    return false;
+  }
+  if (*end == ',') {
+    cfg->threshold = strtoul(end + 1, &end, 10);
+    if (*end == ',') {
+      cfg->ctrBits = strtoul(end + 1, &end, 10);
+    }
+  }
+  return *end == '\0' && cfg->logEntries >= 1 && cfg->logEntries <= 24 && cfg->ctrBits >= 1 && cfg->ctrBits <= 8 &&
+         cfg->threshold < (1u << cfg->ctrBits);
+}
+
+std::string ConfidenceConfigName(const ConfidenceConfig &cfg) {
+  char name[64];
+  snprintf(name, sizeof(name), "jrs-%ux%u-t%u", 1u << cfg.logEntries, cfg.ctrBits, cfg.threshold);
+  return name;
+}
+
+static double Percent(UINT64 part, UINT64 whole) {
+  return whole ? 100.0 * (double)part / (double)whole : 0.0;
+}
+
+std::string ConfidenceReport(const ConfidenceConfig &cfg, const ConfidenceStats &st) {
+  UINT64 high = st.correctHigh + st.incorrectHigh;
+  UINT64 low = st.correctLow + st.incorrectLow;
+  char buf[512];
+  snprintf(buf, sizeof(buf),
+           "    confidence %s: %.2f%% high, PVP %.2f%%, PVN %.2f%%, SPEC %.2f%%, SENS %.2f%%, "
+           "coverage %.2f%%\n",
+           ConfidenceConfigName(cfg).c_str(), Percent(high, high + low), Percent(st.correctHigh, high),
+           Percent(st.incorrectLow, low), Percent(st.incorrectLow, st.incorrectLow + st.incorrectHigh),
+           Percent(st.correctHigh, st.correctHigh + st.correctLow), Percent(low, high + low));
+  return buf;
+}
+
+/////////////////////////////////////////////////////////////
+// resetting counters
+/////////////////////////////////////////////////////////////
+
+ConfidenceEstimator::ConfidenceEstimator(const ConfidenceConfig &c)
+    : cfg(c), mask((1u << c.logEntries) - 1), ctrMax((1u << c.ctrBits) - 1), counters((size_t)1 << c.logEntries, 0),
+      history(0) {
+  memset(&stats, 0, sizeof(stats));
+}
+
+void ConfidenceEstimator::Update(UINT32 PC, bool high, bool correct, bool taken, bool measure) {
+  if (measure) {
+    if (high) {
+      stats.correctHigh += correct;
+      stats.incorrectHigh += !correct;
+    }
+    else {
+      stats.correctLow += correct;
+      stats.incorrectLow += !correct;
+    }
+  }
+
+  uint8_t &ctr = counters[Index(PC)];
+  if (!correct) {
+    ctr = 0;
+  }
+  else if (ctr < ctrMax) {
+    ctr++;
+  }
+  history = (history << 1) | (taken ? 1 : 0);
+}
@@ -0,0 +1,79 @@
+#ifndef _CONFIDENCE_H_
+#define _CONFIDENCE_H_
+
+#include <string>
+#include <vector>
+
+#include "bpsim.h"
+
+/////////////////////////////////////////////////////////////
+// confidence estimation
+/////////////////////////////////////////////////////////////
+/*
+JRS resetting counters (Jacobsen, Rotenberg and Smith, "Assigning
+confidence to conditional branch predictions"): 2^LogEntries counters
+of CtrBits bits indexed by PC xor global history, the same index as a
+gshare. A correct prediction increments the counter (saturating), a
+misprediction resets it to 0, so a counter is the number of correct
+predictions since the last miss in its context. A prediction is high
+confidence when its counter is at least the threshold.
+
+The estimator only sees the PC, the outcome and whether the prediction
+was right, so one runs next to any predictor without touching it.
+Statistics, over all conditional branches:
+
+  PVP       high confidence predictions that were right
+  PVN       low confidence predictions that were wrong
+  SPEC      mispredictions flagged low confidence
+  SENS      correct predictions flagged high confidence
+  coverage  branches flagged low confidence, what gating would stall
+*/
+
+struct ConfidenceConfig {
+  unsigned logEntries;
+  unsigned ctrBits;
+  unsigned threshold;
+};
+
+// parses <log entries>[,<threshold>[,<ctr bits>]], false on a syntax error
+bool ParseConfidenceConfig(const char *spec, ConfidenceConfig *cfg);
+
+// jrs-<entries>x<ctr bits>-t<threshold>
+std::string ConfidenceConfigName(const ConfidenceConfig &cfg);
+
+struct ConfidenceStats {
+  UINT64 correctHigh;
+  UINT64 incorrectHigh;
+  UINT64 correctLow;
+  UINT64 incorrectLow;
+};
+
+std::string ConfidenceReport(const ConfidenceConfig &cfg, const ConfidenceStats &st);
+
+class ConfidenceEstimator {
+ public:
+  explicit ConfidenceEstimator(const ConfidenceConfig &cfg);
+
+  // confidence bit of the next prediction for PC, true = high
+  bool Estimate(UINT32 PC) const {
+    return counters[Index(PC)] >= cfg.threshold;
+  }
+
+  // trains on the outcome of the branch Estimate was called for,
+  // counted in the statistics when measure is set
+  void Update(UINT32 PC, bool high, bool correct, bool taken, bool measure = true);
+
+  const ConfidenceStats &Stats() const { return stats; }
+
+ private:
+  UINT32 Index(UINT32 PC) const { return (PC ^ history) & mask; }
+
+  ConfidenceConfig cfg;
+  UINT32 mask;
+  UINT32 ctrMax;
+  std::vector<uint8_t> counters;
+  UINT32 history;
+  ConfidenceStats stats;
+};
+
+#endif
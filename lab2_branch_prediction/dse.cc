@@ -0,0 +1,518 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bpsim.h"
+#include "hybrid.h"
+#include "work_pool.h"
+
+/////////////////////////////////////////////////////////////
+// design-space exploration
+/////////////////////////////////////////////////////////////
+/*
+Runs every candidate predictor under a storage budget on a set of
+traces and prints the Pareto frontier of mean MPKI against storage
+bytes.
+
+Candidates are the registered predictors (predictor.h, plus the
+predictor_grid.cc sweep of table size, history length and counter
+width with -g), or the -p list. Names driving the same tables are
+evaluated once, alias shadows are skipped.
+With -H n a second round composes hybrid:<a>+<b> of two first round
+frontier points that fit the budget together with the chooser, best
+component first, and evaluates up to n of them (at most
+HYBRID_MAX_SLOTS).
+
+Each job is one trace and a batch of up to -k candidates that do not
+share tables, run the way fanout runs them; jobs are spread over a
+WorkStealingPool (work_pool.h), biggest candidates first.
+With -c every result is appended to a cache file as
+
+  <predictor> <storage bits> <trace> <trace size> <trace mtime> <insts> <cond br> <mispred>
+
+(tab separated), and a rerun only evaluates the pairs that are not in
+it yet, so an interrupted sweep resumes where it stopped. Results are
+keyed by name and storage, changing a template without changing
+either needs a fresh cache file.
+
+usage: dse [-j threads] [-g] [-B bytes[K]] [-c cache] [-k batch] [-H n] [-p name[,name...]]
+           <trace> [<trace> ...]
+*/
+
+#define DSE_DEFAULT_BATCH 4
+
+struct DseResult {
+  UINT64 numInsts;
+  UINT64 numCondBr;
+  UINT64 numMispred;
+};
+
+struct DseJob {
+  size_t trace;
+  std::vector<int> preds;
+};
+
+static std::vector<char *> traces;
+static std::vector<std::string> traceKeys;
+static std::map<std::string, DseResult> cache;
+static std::mutex cacheLock;
+static FILE *cacheFile = NULL;
+static std::vector<DseJob> jobs;
+static bool jobFailed = false;
+static size_t batchSize = DSE_DEFAULT_BATCH;
+
+static UINT64 StorageBytes(const PredictorDesc &pred) {
+  return (pred.storageBits + 7) / 8;
+}
+
+// <trace> <size> <mtime>, so a rewritten trace is not served from the cache
+static bool TraceKey(const char *trace, std::string *key) {
+  struct stat st;
+  if (stat(trace, &st) != 0) {
+    return false;
+  }
+  char buf[64];
+  snprintf(buf, sizeof(buf), "\t%lld\t%lld", (long long)st.st_size, (long long)st.st_mtime);
+  *key = std::string(trace) + buf;
+  return true;
+}
+
+static std::string CacheKey(const PredictorDesc &pred, size_t t) {
+  char bits[32];
+  snprintf(bits, sizeof(bits), "\t%llu\t", (unsigned long long)pred.storageBits);
+  return pred.name + std::string(bits) + traceKeys[t];
+}
+
+static bool Cached(const PredictorDesc &pred, size_t t, DseResult *res = NULL) {
+  std::lock_guard<std::mutex> guard(cacheLock);
+  std::map<std::string, DseResult>::const_iterator it = cache.find(CacheKey(pred, t));
+  if (it == cache.end()) {
+    return false;
+  }
+  if (res != NULL) {
+    *res = it->second;
+  }
+  return true;
+}
+
+static void LoadCache(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (f != NULL) {
+    char line[4096];
+    while (fgets(line, sizeof(line), f) != NULL) {
+      // the key is everything before the last three fields
+      char *fields[3];
+      char *end = line + strcspn(line, "\n");
+      *end = '\0';
+      int n = 0;
+      for (char *p = end; p > line && n < 3; p--) {
+        if (p[-1] == '\t') {
+          fields[2 - n++] = p;
+          p[-1] = '\0';
+        }
+      }
+      if (n < 3) {
+        continue;
+      }
+      DseResult res;
+      res.numInsts = strtoull(fields[0], NULL, 10);
+      res.numCondBr = strtoull(fields[1], NULL, 10);
+      res.numMispred = strtoull(fields[2], NULL, 10);
+      cache[line] = res;
+    }
+    fclose(f);
+  }
+
+  cacheFile = fopen(path, "a");
+  if (cacheFile == NULL) {
+    fprintf(stderr, "dse: cannot write cache %s\n", path);
+    exit(-1);
+  }
+}
+
+static void StoreResult(const PredictorDesc &pred, size_t t, const DseResult &res) {
+  std::string key = CacheKey(pred, t);
+  std::lock_guard<std::mutex> guard(cacheLock);
+  cache[key] = res;
+  if (cacheFile != NULL) {
+    fprintf(cacheFile, "%s\t%llu\t%llu\t%llu\n", key.c_str(), (unsigned long long)res.numInsts,
+            (unsigned long long)res.numCondBr, (unsigned long long)res.numMispred);
+    fflush(cacheFile);
+  }
+}
+
+static void RunJob(size_t j) {
+  std::vector<PredictorDesc> &registry = PredictorRegistry();
+  const DseJob &job = jobs[j];
+
+  TraceSource *src = OpenTrace(traces[job.trace]);
+  if (src == NULL) {
+    fprintf(stderr, "dse: cannot open trace %s\n", traces[job.trace]);
+    std::lock_guard<std::mutex> guard(cacheLock);
+    jobFailed = true;
+    return;
+  }
+
+  for (size_t p = 0; p < job.preds.size(); p++) {
+    registry[job.preds[p]].Init();
+  }
+
+  UINT64 numInsts = 0;
+  UINT64 numCondBr = 0;
+  std::vector<UINT64> numMispred(job.preds.size(), 0);
+
+  std::vector<BranchRecord> chunk(BRANCH_CHUNK_SIZE);
+  size_t count;
+  while ((count = src->Next(&chunk[0], chunk.size())) > 0) {
+    for (size_t i = 0; i < count; i++) {
+      numInsts += chunk[i].instGap;
+      numCondBr += chunk[i].opType == OPTYPE_BRANCH_COND;
+    }
+    for (size_t p = 0; p < job.preds.size(); p++) {
+      const PredictorDesc &pred = registry[job.preds[p]];
+      UINT64 mispred = 0;
+      for (size_t i = 0; i < count; i++) {
+        const BranchRecord &rec = chunk[i];
+        if (rec.opType != OPTYPE_BRANCH_COND) {
+          continue;
+        }
+        bool predDir = pred.Get(rec.PC);
+        pred.Update(rec.PC, rec.taken, predDir, rec.branchTarget);
+        mispred += (predDir != rec.taken);
+      }
+      numMispred[p] += mispred;
+    }
+  }
+  delete src;
+
+  for (size_t p = 0; p < job.preds.size(); p++) {
+    DseResult res;
+    res.numInsts = numInsts;
+    res.numCondBr = numCondBr;
+    res.numMispred = numMispred[p];
+    StoreResult(registry[job.preds[p]], job.trace, res);
+  }
+}
+
+static bool ByStorageDesc(int a, int b) {
+  return PredictorRegistry()[a].storageBits > PredictorRegistry()[b].storageBits;
+}
+
+// evaluates every candidate on every trace that is not cached yet
+static void Evaluate(std::vector<int> candidates, WorkStealingPool &pool) {
+  std::vector<PredictorDesc> &registry = PredictorRegistry();
+  std::stable_sort(candidates.begin(), candidates.end(), ByStorageDesc);
+
+  // conflict free batches per trace, a candidate that shares tables with
+  // the open batch goes into the next one
+  std::vector<std::vector<DseJob> > perTrace(traces.size());
+  size_t numCached = 0;
+  for (size_t t = 0; t < traces.size(); t++) {
+    std::vector<int> pending;
+    for (size_t c = 0; c < candidates.size(); c++) {
+      if (Cached(registry[candidates[c]], t)) {
+        numCached++;
+      }
+      else {
+        pending.push_back(candidates[c]);
+      }
+    }
+
+    while (!pending.empty()) {
+      DseJob job;
+      job.trace = t;
+      std::vector<int> rest;
+      for (size_t c = 0; c < pending.size(); c++) {
+        job.preds.push_back(pending[c]);
+        if (job.preds.size() > batchSize || !CheckPredictorConflicts(job.preds, false)) {
+          job.preds.pop_back();
+          if (job.preds.empty()) {
+            // conflicts with itself, it would never fit a batch
+            CheckPredictorConflicts(std::vector<int>(1, pending[c]));
+            exit(-1);
+          }
+          rest.push_back(pending[c]);
+        }
+      }
+      perTrace[t].push_back(job);
+      pending.swap(rest);
+    }
+  }
+
+  // the biggest batch of every trace first
+  jobs.clear();
+  for (size_t round = 0;; round++) {
+    size_t before = jobs.size();
+    for (size_t t = 0; t < traces.size(); t++) {
+      if (round < perTrace[t].size()) {
+        jobs.push_back(perTrace[t][round]);
+      }
+    }
+    if (jobs.size() == before) {
+      break;
+    }
+  }
+
+  fprintf(stderr, "dse: %zu candidates, %zu jobs, %zu results cached\n", candidates.size(), jobs.size(),
+          numCached);
+  pool.Run(jobs.size(), RunJob);
+  if (jobFailed) {
+    exit(-1);
+  }
+  fprintf(stderr, "dse: %zu jobs stolen\n", pool.NumStolen());
+}
+
+/////////////////////////////////////////////////////////////
+// Pareto frontier
+/////////////////////////////////////////////////////////////
+
+struct DsePoint {
+  int idx;
+  UINT64 bytes;
+  double mpki;
+  bool frontier;
+};
+
+static bool ByBytes(const DsePoint &a, const DsePoint &b) {
+  return a.bytes != b.bytes ? a.bytes < b.bytes : a.mpki < b.mpki;
+}
+
+static bool ByMpki(const DsePoint &a, const DsePoint &b) {
+  return a.mpki != b.mpki ? a.mpki < b.mpki : a.bytes < b.bytes;
+}
+
+// mean MPKI over the traces, as the lab reports it
+static DsePoint MakePoint(int idx) {
+  const PredictorDesc &pred = PredictorRegistry()[idx];
+  DsePoint pt;
+  pt.idx = idx;
+  pt.bytes = StorageBytes(pred);
+  pt.mpki = 0.0;
+  pt.frontier = false;
+  for (size_t t = 0; t < traces.size(); t++) {
+    DseResult res;
+    Cached(pred, t, &res);
+    pt.mpki += res.numInsts ? 1000.0 * (double)res.numMispred / (double)res.numInsts : 0.0;
+  }
+  pt.mpki /= traces.size();
+  return pt;
+}
+
+// sorts by storage and marks the points no smaller point beats or ties
+static void MarkFrontier(std::vector<DsePoint> *points) {
+  std::sort(points->begin(), points->end(), ByBytes);
+  double best = 0.0;
+  for (size_t i = 0; i < points->size(); i++) {
+    DsePoint &pt = (*points)[i];
+    pt.frontier = i == 0 || pt.mpki < best;
+    if (pt.frontier) {
+      best = pt.mpki;
+    }
+  }
+}
+
+// up to n hybrids of two frontier points within budget, best component first
+static std::vector<int> ComposeHybrids(const std::vector<DsePoint> &points, unsigned n, UINT64 budget) {
+  std::vector<DsePoint> frontier;
+  for (size_t i = 0; i < points.size(); i++) {
+    if (points[i].frontier) {
+      frontier.push_back(points[i]);
+    }
+  }
+  std::sort(frontier.begin(), frontier.end(), ByMpki);
+
+  std::vector<PredictorDesc> &registry = PredictorRegistry();
+  std::vector<int> hybrids;
+  for (size_t a = 0; a < frontier.size() && hybrids.size() < n; a++) {
+    for (size_t b = a + 1; b < frontier.size() && hybrids.size() < n; b++) {
+      const PredictorDesc &first = registry[frontier[a].idx];
+      const PredictorDesc &second = registry[frontier[b].idx];
+      UINT64 bits = ((UINT64)2 << HYBRID_DEFAULT_LOG_CHOOSER) + first.storageBits + second.storageBits;
+      if (budget > 0 && (bits + 7) / 8 > budget) {
+        continue;
+      }
+      std::vector<int> pair;
+      pair.push_back(frontier[a].idx);
+      pair.push_back(frontier[b].idx);
+      if (!CheckPredictorConflicts(pair, false)) {
+        continue;
+      }
+      std::string spec = std::string("hybrid:") + first.name + "+" + second.name;
+      int idx = FindPredictor(spec.c_str());
+      if (idx < 0) {
+        return hybrids;
+      }
+      hybrids.push_back(idx);
+    }
+  }
+  return hybrids;
+}
+
+static void PrintPoints(const std::vector<DsePoint> &points, UINT64 budget) {
+  std::vector<PredictorDesc> &registry = PredictorRegistry();
+  if (budget > 0) {
+    printf("budget %llu bytes, %zu traces\n", (unsigned long long)budget, traces.size());
+  }
+  else {
+    printf("no budget, %zu traces\n", traces.size());
+  }
+  printf("  %-40s %12s %10s\n", "predictor", "bytes", "MPKI");
+  for (size_t i = 0; i < points.size(); i++) {
+    const DsePoint &pt = points[i];
+    printf("%c %-40s %12llu %10.4f\n", pt.frontier ? '*' : ' ', registry[pt.idx].name,
+           (unsigned long long)pt.bytes, pt.mpki);
+  }
+
+  printf("\nPARETO_FRONTIER\n");
+  for (size_t i = 0; i < points.size(); i++) {
+    if (points[i].frontier) {
+      printf("  %-40s %12llu %10.4f\n", registry[points[i].idx].name, (unsigned long long)points[i].bytes,
+             points[i].mpki);
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////
+// driver
+/////////////////////////////////////////////////////////////
+
+static void Usage(char *prog) {
+  fprintf(stderr,
+          "usage: %s [-j threads] [-g] [-B bytes[K]] [-c cache] [-k batch] [-H n] [-p name[,name...]]\n"
+          "          <trace> [<trace> ...]\n",
+          prog);
+  exit(-1);
+}
+
+// bytes, or KB with a K suffix
+static bool ParseBudget(const char *arg, UINT64 *budget) {
+  char *end;
+  double value = strtod(arg, &end);
+  if (*end == 'K' || *end == 'k') {
+    value *= 1024;
+    end++;
+  }
+  *budget = (UINT64)value;
+  return *end == '\0' && value >= 0;
+}
+
+int main(int argc, char *argv[]) {
+  RegisterDefaultPredictors();
+
+  unsigned numThreads = std::thread::hardware_concurrency();
+  UINT64 budget = 0;
+  unsigned numHybrids = 0;
+  std::vector<int> candidates;
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; i++) {
+    if (strcmp(argv[i], "-g") == 0) {
+      RegisterPredictorGrid();
+    }
+    else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      numThreads = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-B") == 0 && i + 1 < argc) {
+      if (!ParseBudget(argv[++i], &budget)) {
+        fprintf(stderr, "dse: bad budget %s\n", argv[i]);
+        Usage(argv[0]);
+      }
+    }
+    else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      LoadCache(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+      batchSize = atoi(argv[++i]);
+      if (batchSize == 0) {
+        batchSize = 1;
+      }
+    }
+    else if (strcmp(argv[i], "-H") == 0 && i + 1 < argc) {
+      numHybrids = std::min(atoi(argv[++i]), HYBRID_MAX_SLOTS);
+    }
+    else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+      for (char *name = strtok(argv[++i], ","); name != NULL; name = strtok(NULL, ",")) {
+        int idx = FindPredictor(name);
+        if (idx < 0) {
+          fprintf(stderr, "dse: unknown predictor %s\n", name);
+          Usage(argv[0]);
+        }
+        // a hybrid whose own parts share tables can never run
+        if (!CheckPredictorConflicts(std::vector<int>(1, idx))) {
+          exit(-1);
+        }
+        candidates.push_back(idx);
+      }
+    }
+    else {
+      Usage(argv[0]);
+    }
+  }
+  for (; i < argc; i++) {
+    traces.push_back(argv[i]);
+    traceKeys.push_back(std::string());
+    if (!TraceKey(argv[i], &traceKeys.back())) {
+      fprintf(stderr, "dse: cannot open trace %s\n", argv[i]);
+      exit(-1);
+    }
+  }
+  if (traces.empty()) {
+    Usage(argv[0]);
+  }
+
+  // every registered predictor once per set of tables, shadows report but predict the same
+  if (candidates.empty()) {
+    for (size_t p = 0; p < PredictorRegistry().size(); p++) {
+      if (PredictorRegistry()[p].Report != NULL) {
+        continue;
+      }
+      candidates.push_back((int)p);
+      if (!CheckPredictorConflicts(candidates, false)) {
+        candidates.pop_back();
+      }
+    }
+  }
+  std::vector<int> inBudget;
+  for (size_t c = 0; c < candidates.size(); c++) {
+    if (budget == 0 || StorageBytes(PredictorRegistry()[candidates[c]]) <= budget) {
+      inBudget.push_back(candidates[c]);
+    }
+  }
+  if (inBudget.empty()) {
+    fprintf(stderr, "dse: no predictor fits in %llu bytes\n", (unsigned long long)budget);
+    exit(-1);
+  }
+
+  WorkStealingPool pool(numThreads);
+  Evaluate(inBudget, pool);
+
+  std::vector<DsePoint> points;
+  for (size_t c = 0; c < inBudget.size(); c++) {
+    points.push_back(MakePoint(inBudget[c]));
+  }
+  MarkFrontier(&points);
+
+  if (numHybrids > 0) {
+    std::vector<int> hybrids = ComposeHybrids(points, numHybrids, budget);
+    if (!hybrids.empty()) {
+      Evaluate(hybrids, pool);
+      for (size_t h = 0; h < hybrids.size(); h++) {
+        points.push_back(MakePoint(hybrids[h]));
+      }
+      MarkFrontier(&points);
+    }
+  }
+
+  PrintPoints(points, budget);
+  if (cacheFile != NULL) {
+    fclose(cacheFile);
+  }
+  return 0;
+}
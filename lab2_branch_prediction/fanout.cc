@@ -0,0 +1,623 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "alias.h"
+#include "bpsim.h"
+#include "confidence.h"
+#include "gshare_sweep.h"
+#include "pipeline.h"
+#include "profile.h"
+#include "sample.h"
+#include "target.h"
+#include "timeline.h"
+
+/////////////////////////////////////////////////////////////
+// fan-out driver
+/////////////////////////////////////////////////////////////
+/*
+Decodes every trace once and feeds each conditional branch to all
+selected predictors.
+Traces are distributed over worker threads, each worker keeps its own
+(thread_local) copy of the predictor state.
+Records are fanned out one chunk at a time, predictor by predictor,
+so the tables of one predictor stay in cache for the whole chunk.
+
+usage: fanout [-j threads] [-g] [-l] [-t top] [-b btb] [-G sweep] [-C confidence] [-i interval]
+              [-s sampling] [-d depth] [-S dir] [-R dir] [-p name[,name...]] <trace> [<trace> ...]
+  -g  also register the budget sweep of predictor_grid.cc
+  -l  list the registered predictors and their storage budget
+  -p  predictors to run, hybrid:<a>+<b>[...][@<log chooser>] composes
+      registered predictors (see hybrid.h), loop:<name> adds a loop
+      predictor to <name> (see loop.h), alias-<name> reports the
+      aliasing in the tables of <name> (see alias.h)
+  -b  <sets>x<ways>[:lru|fifo|random][,<ras depth>] also predicts the
+      targets of taken branches with a BTB and RAS (see target.h),
+      can be given more than once
+  -G  <log sizes>[:<history lengths>][,c<ctr bits>] also runs a gshare
+      for every size and history length in the same pass, e.g. 15:0-15
+      (see gshare_sweep.h), can be given more than once, not with -s
+      or -d and never checkpointed
+  -C  <log entries>[,<threshold>[,<ctr bits>]] tags every prediction of
+      every predictor high or low confidence with JRS resetting
+      counters and reports PVN/SPEC/coverage (see confidence.h)
+  -t  profile every static branch and report the top branches by
+      mispredictions for each trace and predictor (see profile.h)
+  -i  <interval insts>[,<dir>] MPKI per interval of instructions,
+      streamed to <dir>/<trace>.mpki.csv, and the warm-up length of
+      every predictor (see timeline.h), not with -s
+  -s  <period>,<warm>,<window> sampled evaluation: MPKI with a 95%
+      confidence interval from one window per period (see sample.h)
+  -d  <depth>[,nonspec] trains the counters depth branches after the
+      prediction, with speculative (default) or commit time history
+      updates (see pipeline.h), not with -s; the alias-<name> shadows
+      have no delayed update model and are left out of the default set
+  -S  save every predictor's state to <dir>/<trace>.<predictor>.bps at
+      the end of each trace
+  -R  start each predictor from <dir>/<trace>.<predictor>.bps instead of
+      Init (see predictor_state.h)
+*/
+
+struct PredictorStats {
+  UINT64 numMispred;
+};
+
+struct TraceResult {
+  bool ok;
+  bool saved; // every -S checkpoint was written
+  UINT64 numInsts;
+  UINT64 numCondBr;
+  std::vector<PredictorStats> stats;
+  std::vector<std::string> reports;
+  std::vector<ConfidenceStats> confidence;
+  std::vector<TargetStats> targets;
+  std::vector<std::vector<UINT64> > sweeps;
+  SampleCounts samples;
+  BranchProfile *profile;
+  std::vector<std::string> warmups;
+};
+
+static std::vector<char *> traces;
+static std::vector<int> selected;
+static std::vector<TraceResult> results;
+static std::atomic<size_t> nextTrace(0);
+static unsigned numTopBranches = 0;
+static std::vector<TargetConfig> targetConfigs;
+static std::vector<GshareSweepConfig> sweepConfigs;
+static bool estimating = false;
+static bool timelined = false;
+static TimelineConfig timelineConfig;
+static ConfidenceConfig confidenceConfig;
+static bool sampling = false;
+static SampleConfig sampleConfig;
+static bool pipelined = false;
+static PipelineConfig pipelineConfig;
+static const char *saveDir = NULL;
+static const char *restoreDir = NULL;
+
+// <dir>/<trace file name>.<predictor>.bps
+static std::string CheckpointPath(const char *dir, const char *trace, const char *pred) {
+  const char *base = strrchr(trace, '/');
+  return std::string(dir) + "/" + (base ? base + 1 : trace) + "." + pred + ".bps";
+}
+
+static void RunTrace(size_t t) {
+  std::vector<PredictorDesc> &registry = PredictorRegistry();
+  TraceResult &res = results[t];
+  res.ok = false;
+  res.saved = true;
+  res.numInsts = 0;
+  res.numCondBr = 0;
+  res.stats.assign(selected.size(), PredictorStats());
+  res.reports.assign(selected.size(), std::string());
+  res.profile = NULL;
+
+  TraceSource *src = OpenTrace(traces[t]);
+  if (src == NULL) {
+    fprintf(stderr, "fanout: cannot open trace %s\n", traces[t]);
+    return;
+  }
+
+  for (size_t p = 0; p < selected.size(); p++) {
+    registry[selected[p]].Init();
+    if (restoreDir != NULL) {
+      std::string path = CheckpointPath(restoreDir, traces[t], registry[selected[p]].name);
+      if (!LoadPredictorFile(registry[selected[p]], path.c_str())) {
+        delete src;
+        return;
+      }
+    }
+  }
+  res.samples.mispred.assign(selected.size(), std::vector<UINT64>());
+
+  std::vector<PredictorPipeline> pipes;
+  if (pipelined) {
+    for (size_t p = 0; p < selected.size(); p++) {
+      pipes.push_back(PredictorPipeline(registry[selected[p]], pipelineConfig));
+    }
+  }
+
+  BranchProfile *profile = NULL;
+  if (numTopBranches > 0) {
+    profile = new BranchProfile(selected.size());
+  }
+
+  std::vector<TargetPredictor> targets;
+  for (size_t b = 0; b < targetConfigs.size(); b++) {
+    targets.push_back(TargetPredictor(targetConfigs[b]));
+  }
+
+  // one estimator per predictor, each sees its own correct/incorrect stream
+  std::vector<ConfidenceEstimator> estimators;
+  if (estimating) {
+    estimators.assign(selected.size(), ConfidenceEstimator(confidenceConfig));
+  }
+
+  MpkiTimeline *timeline = NULL;
+  if (timelined) {
+    std::vector<const char *> names;
+    for (size_t p = 0; p < selected.size(); p++) {
+      names.push_back(registry[selected[p]].name);
+    }
+    timeline = new MpkiTimeline(timelineConfig, selected.size());
+    if (!timeline->Open(traces[t], names)) {
+      delete timeline;
+      delete profile;
+      delete src;
+      return;
+    }
+  }
+
+  std::vector<GshareSweep> sweeps;
+  for (size_t g = 0; g < sweepConfigs.size(); g++) {
+    sweeps.push_back(GshareSweep(sweepConfigs[g]));
+  }
+
+  std::vector<BranchRecord> chunk(BRANCH_CHUNK_SIZE);
+  std::vector<size_t> slots(BRANCH_CHUNK_SIZE);
+  std::vector<uint8_t> phase(BRANCH_CHUNK_SIZE);
+  std::vector<size_t> sample(BRANCH_CHUNK_SIZE);
+  std::vector<size_t> interval(BRANCH_CHUNK_SIZE);
+  size_t count;
+  while ((count = src->Next(&chunk[0], chunk.size())) > 0) {
+    if (profile != NULL) {
+      profile->Reserve(count);
+    }
+    for (size_t i = 0; i < count; i++) {
+      if (sampling) {
+        // non-branch records go with the next conditional branch
+        phase[i] = GetSamplePhase(sampleConfig, res.numCondBr);
+        sample[i] = res.numCondBr / sampleConfig.period;
+        if (sample[i] >= res.samples.insts.size()) {
+          res.samples.insts.push_back(0);
+          res.samples.branches.push_back(0);
+          for (size_t p = 0; p < selected.size(); p++) {
+            res.samples.mispred[p].push_back(0);
+          }
+        }
+        if (phase[i] == SAMPLE_MEASURE) {
+          res.samples.insts[sample[i]] += chunk[i].instGap;
+          res.samples.branches[sample[i]] += chunk[i].opType == OPTYPE_BRANCH_COND;
+        }
+      }
+
+      res.numInsts += chunk[i].instGap;
+      if (timeline != NULL) {
+        interval[i] = timeline->Advance(chunk[i].instGap);
+      }
+      if (chunk[i].opType == OPTYPE_BRANCH_COND) {
+        res.numCondBr++;
+        if (profile != NULL) {
+          slots[i] = profile->Record(chunk[i].PC, chunk[i].taken);
+        }
+      }
+    }
+
+    for (size_t p = 0; p < selected.size(); p++) {
+      const PredictorDesc &pred = registry[selected[p]];
+      ConfidenceEstimator *conf = estimating ? &estimators[p] : NULL;
+      UINT64 numMispred = 0;
+
+      if (sampling) {
+        std::vector<UINT64> &sampleMispred = res.samples.mispred[p];
+        for (size_t i = 0; i < count; i++) {
+          const BranchRecord &rec = chunk[i];
+          if (rec.opType != OPTYPE_BRANCH_COND || phase[i] == SAMPLE_SKIP) {
+            continue;
+          }
+          bool predDir = pred.Get(rec.PC);
+          pred.Update(rec.PC, rec.taken, predDir, rec.branchTarget);
+          if (conf != NULL) {
+            conf->Update(rec.PC, conf->Estimate(rec.PC), predDir == rec.taken, rec.taken,
+                         phase[i] == SAMPLE_MEASURE);
+          }
+          if (phase[i] == SAMPLE_MEASURE && predDir != rec.taken) {
+            numMispred++;
+            sampleMispred[sample[i]]++;
+            if (profile != NULL) {
+              profile->Mispredict(p, slots[i]);
+            }
+          }
+        }
+        res.stats[p].numMispred += numMispred;
+        continue;
+      }
+
+      if (pipelined) {
+        PredictorPipeline &pipe = pipes[p];
+        for (size_t i = 0; i < count; i++) {
+          const BranchRecord &rec = chunk[i];
+          if (rec.opType != OPTYPE_BRANCH_COND) {
+            continue;
+          }
+          bool high = conf != NULL && conf->Estimate(rec.PC);
+          bool mispred = pipe.Process(rec);
+          if (conf != NULL) {
+            conf->Update(rec.PC, high, !mispred, rec.taken);
+          }
+          if (mispred) {
+            numMispred++;
+            if (profile != NULL) {
+              profile->Mispredict(p, slots[i]);
+            }
+            if (timeline != NULL) {
+              timeline->Mispredict(p, interval[i]);
+            }
+          }
+        }
+        res.stats[p].numMispred += numMispred;
+        continue;
+      }
+
+      for (size_t i = 0; i < count; i++) {
+        const BranchRecord &rec = chunk[i];
+        if (rec.opType != OPTYPE_BRANCH_COND) {
+          continue;
+        }
+        bool predDir = pred.Get(rec.PC);
+        pred.Update(rec.PC, rec.taken, predDir, rec.branchTarget);
+        numMispred += (predDir != rec.taken);
+        if (conf != NULL) {
+          conf->Update(rec.PC, conf->Estimate(rec.PC), predDir == rec.taken, rec.taken);
+        }
+        if (profile != NULL && predDir != rec.taken) {
+          profile->Mispredict(p, slots[i]);
+        }
+        if (timeline != NULL && predDir != rec.taken) {
+          timeline->Mispredict(p, interval[i]);
+        }
+      }
+      res.stats[p].numMispred += numMispred;
+    }
+
+    for (size_t g = 0; g < sweeps.size(); g++) {
+      sweeps[g].Process(&chunk[0], count);
+    }
+
+    if (timeline != NULL) {
+      timeline->Flush(false);
+    }
+
+    for (size_t b = 0; b < targets.size(); b++) {
+      for (size_t i = 0; i < count; i++) {
+        targets[b].Process(chunk[i]);
+      }
+    }
+  }
+
+  for (size_t p = 0; p < pipes.size(); p++) {
+    pipes[p].Drain();
+  }
+
+  for (size_t b = 0; b < targets.size(); b++) {
+    res.targets.push_back(targets[b].Stats());
+  }
+  for (size_t p = 0; p < estimators.size(); p++) {
+    res.confidence.push_back(estimators[p].Stats());
+  }
+  for (size_t g = 0; g < sweeps.size(); g++) {
+    res.sweeps.push_back(sweeps[g].Mispred());
+  }
+  if (timeline != NULL) {
+    timeline->Flush(true);
+    for (size_t p = 0; p < selected.size(); p++) {
+      res.warmups.push_back(timeline->Report(p));
+    }
+    delete timeline;
+  }
+
+  for (size_t p = 0; p < selected.size(); p++) {
+    if (registry[selected[p]].Report != NULL) {
+      res.reports[p] = registry[selected[p]].Report();
+    }
+  }
+
+  if (saveDir != NULL) {
+    for (size_t p = 0; p < selected.size(); p++) {
+      std::string path = CheckpointPath(saveDir, traces[t], registry[selected[p]].name);
+      res.saved = SavePredictorFile(registry[selected[p]], path.c_str()) && res.saved;
+    }
+  }
+
+  delete src;
+  res.profile = profile;
+  res.ok = true;
+}
+
+static void Worker() {
+  size_t t;
+  while ((t = nextTrace++) < traces.size()) {
+    RunTrace(t);
+  }
+}
+
+static void PrintResults() {
+  std::vector<PredictorDesc> &registry = PredictorRegistry();
+
+  for (size_t t = 0; t < traces.size(); t++) {
+    TraceResult &res = results[t];
+    if (!res.ok) {
+      continue;
+    }
+
+    printf("\n%s\n", traces[t]);
+    printf("  NUM_INSTRUCTIONS            \t : %10llu\n", (unsigned long long)res.numInsts);
+    printf("  NUM_CONDITIONAL_BR          \t : %10llu\n", (unsigned long long)res.numCondBr);
+    for (size_t p = 0; p < selected.size(); p++) {
+      const char *name = registry[selected[p]].name;
+      UINT64 numMispred = res.stats[p].numMispred;
+      printf("  NUM_MISPREDICTIONS_%-10s\t : %10llu\n", name, (unsigned long long)numMispred);
+      if (sampling) {
+        // numMispred only counts the measured windows
+        double mean, ci95;
+        size_t numSamples;
+        EstimateMpki(sampleConfig, res.samples, p, &mean, &ci95, &numSamples);
+        printf("  MISPRED_PER_1K_INST_%-9s\t : %10.4f +- %.4f (95%%, %zu samples)\n", name, mean, ci95,
+               numSamples);
+      }
+      else {
+        printf("  MISPRED_PER_1K_INST_%-9s\t : %10.4f\n", name,
+               res.numInsts ? 1000.0 * (double)numMispred / (double)res.numInsts : 0.0);
+      }
+      fputs(res.reports[p].c_str(), stdout);
+      if (timelined) {
+        fputs(res.warmups[p].c_str(), stdout);
+      }
+      if (estimating) {
+        fputs(ConfidenceReport(confidenceConfig, res.confidence[p]).c_str(), stdout);
+      }
+    }
+
+    for (size_t g = 0; g < sweepConfigs.size(); g++) {
+      for (size_t l = 0; l < sweepConfigs[g].lanes.size(); l++) {
+        std::string name = GshareSweepName(sweepConfigs[g], l);
+        UINT64 numMispred = res.sweeps[g][l];
+        printf("  NUM_MISPREDICTIONS_%-10s\t : %10llu\n", name.c_str(), (unsigned long long)numMispred);
+        printf("  MISPRED_PER_1K_INST_%-9s\t : %10.4f\n", name.c_str(),
+               res.numInsts ? 1000.0 * (double)numMispred / (double)res.numInsts : 0.0);
+      }
+    }
+
+    for (size_t b = 0; b < targetConfigs.size(); b++) {
+      std::string name = TargetConfigName(targetConfigs[b]);
+      const TargetStats &st = res.targets[b];
+      printf("  NUM_TARGET_MISPRED_%-10s\t : %10llu\n", name.c_str(), (unsigned long long)st.numMispred);
+      printf("  TARGET_MISPRED_PER_1K_INST_%-9s\t : %10.4f\n", name.c_str(),
+             res.numInsts ? 1000.0 * (double)st.numMispred / (double)res.numInsts : 0.0);
+      printf("    taken branches %llu, btb miss %llu, btb wrong target %llu, returns %llu, ras wrong %llu, "
+             "ras overflow %llu, ras underflow %llu\n",
+             (unsigned long long)st.numTakenBr, (unsigned long long)st.btbMiss, (unsigned long long)st.btbWrong,
+             (unsigned long long)st.numReturns, (unsigned long long)st.rasWrong,
+             (unsigned long long)st.rasOverflow, (unsigned long long)st.rasUnderflow);
+    }
+
+    if (res.profile != NULL) {
+      std::vector<const char *> names;
+      for (size_t p = 0; p < selected.size(); p++) {
+        names.push_back(registry[selected[p]].name);
+      }
+      res.profile->Report(stdout, names, numTopBranches);
+      delete res.profile;
+      res.profile = NULL;
+    }
+  }
+}
+
+static void ListPredictors() {
+  std::vector<PredictorDesc> &registry = PredictorRegistry();
+  for (size_t i = 0; i < registry.size(); i++) {
+    printf("%-28s %10llu bits %8.2f KB\n", registry[i].name,
+           (unsigned long long)registry[i].storageBits, registry[i].storageBits / 8192.0);
+  }
+}
+
+static void Usage(char *prog) {
+  fprintf(stderr,
+          "usage: %s [-j threads] [-g] [-l] [-t top] [-b btb] [-G sweep] [-C confidence] [-i interval[,dir]]\n"
+          "          [-s period,warm,window] [-d depth[,nonspec]] [-S dir] [-R dir] [-p name[,name...]]\n"
+          "          <trace> [<trace> ...]\n",
+          prog);
+  fprintf(stderr, "predictors:");
+  std::vector<PredictorDesc> &registry = PredictorRegistry();
+  for (size_t i = 0; i < registry.size(); i++) {
+    fprintf(stderr, " %s", registry[i].name);
+  }
+  fprintf(stderr, "\nnot with -d:");
+  for (size_t i = 0; i < registry.size(); i++) {
+    if (registry[i].PipePredict == NULL) {
+      fprintf(stderr, " %s", registry[i].name);
+    }
+  }
+  fprintf(stderr, "\n");
+  exit(-1);
+}
+
+static void SelectPredictors(char *list, char *prog) {
+  for (char *name = strtok(list, ","); name != NULL; name = strtok(NULL, ",")) {
+    int idx = FindPredictor(name);
+    if (idx < 0) {
+      fprintf(stderr, "fanout: unknown predictor %s\n", name);
+      Usage(prog);
+    }
+    selected.push_back(idx);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  RegisterDefaultPredictors();
+  RegisterAliasShadows();
+
+  unsigned numThreads = std::thread::hardware_concurrency();
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; i++) {
+    if (strcmp(argv[i], "-g") == 0) {
+      RegisterPredictorGrid();
+    }
+    else if (strcmp(argv[i], "-l") == 0) {
+      ListPredictors();
+      return 0;
+    }
+    else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      numThreads = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      numTopBranches = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+      TargetConfig cfg;
+      if (!ParseTargetConfig(argv[++i], &cfg)) {
+        fprintf(stderr, "fanout: bad BTB configuration %s\n", argv[i]);
+        Usage(argv[0]);
+      }
+      targetConfigs.push_back(cfg);
+    }
+    else if (strcmp(argv[i], "-C") == 0 && i + 1 < argc) {
+      estimating = ParseConfidenceConfig(argv[++i], &confidenceConfig);
+      if (!estimating) {
+        fprintf(stderr, "fanout: bad confidence estimator %s\n", argv[i]);
+        Usage(argv[0]);
+      }
+    }
+    else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+      timelined = ParseTimelineConfig(argv[++i], &timelineConfig);
+      if (!timelined) {
+        fprintf(stderr, "fanout: bad interval %s\n", argv[i]);
+        Usage(argv[0]);
+      }
+    }
+    else if (strcmp(argv[i], "-G") == 0 && i + 1 < argc) {
+      GshareSweepConfig cfg;
+      if (!ParseGshareSweep(argv[++i], &cfg)) {
+        fprintf(stderr, "fanout: bad gshare sweep %s\n", argv[i]);
+        Usage(argv[0]);
+      }
+      sweepConfigs.push_back(cfg);
+    }
+    else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      sampling = ParseSampleConfig(argv[++i], &sampleConfig);
+      if (!sampling) {
+        fprintf(stderr, "fanout: bad sampling %s\n", argv[i]);
+        Usage(argv[0]);
+      }
+    }
+    else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+      pipelined = ParsePipelineConfig(argv[++i], &pipelineConfig);
+      if (!pipelined) {
+        fprintf(stderr, "fanout: bad pipeline depth %s\n", argv[i]);
+        Usage(argv[0]);
+      }
+    }
+    else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) {
+      saveDir = argv[++i];
+    }
+    else if (strcmp(argv[i], "-R") == 0 && i + 1 < argc) {
+      restoreDir = argv[++i];
+    }
+    else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+      SelectPredictors(argv[++i], argv[0]);
+    }
+    else {
+      Usage(argv[0]);
+    }
+  }
+  for (; i < argc; i++) {
+    traces.push_back(argv[i]);
+  }
+  if (traces.empty()) {
+    Usage(argv[0]);
+  }
+
+  // default to every registered predictor, skipping names for tables already selected
+  // and, with -d, the ones without a delayed update model
+  if (selected.empty()) {
+    std::string skipped;
+    for (size_t p = 0; p < PredictorRegistry().size(); p++) {
+      if (pipelined && PredictorRegistry()[p].PipePredict == NULL) {
+        skipped = skipped + " " + PredictorRegistry()[p].name;
+        continue;
+      }
+      selected.push_back((int)p);
+      if (!CheckPredictorConflicts(selected, false)) {
+        selected.pop_back();
+      }
+    }
+    if (!skipped.empty()) {
+      fprintf(stderr, "fanout: no delayed update model, skipping%s\n", skipped.c_str());
+    }
+  }
+  if (!CheckPredictorConflicts(selected)) {
+    exit(-1);
+  }
+  if (timelined && sampling) {
+    fprintf(stderr, "fanout: -i and -s cannot be combined\n");
+    exit(-1);
+  }
+  if (!sweepConfigs.empty() && (sampling || pipelined)) {
+    fprintf(stderr, "fanout: -G cannot be combined with -s or -d\n");
+    exit(-1);
+  }
+  if (pipelined) {
+    if (sampling) {
+      fprintf(stderr, "fanout: -d and -s cannot be combined\n");
+      exit(-1);
+    }
+    for (size_t p = 0; p < selected.size(); p++) {
+      if (PredictorRegistry()[selected[p]].PipePredict == NULL) {
+        fprintf(stderr, "fanout: %s has no delayed update model\n", PredictorRegistry()[selected[p]].name);
+        exit(-1);
+      }
+    }
+  }
+
+  if (numThreads == 0) {
+    numThreads = 1;
+  }
+  if (numThreads > traces.size()) {
+    numThreads = traces.size();
+  }
+
+  results.resize(traces.size());
+
+  std::vector<std::thread> workers;
+  for (unsigned w = 1; w < numThreads; w++) {
+    workers.push_back(std::thread(Worker));
+  }
+  Worker();
+  for (size_t w = 0; w < workers.size(); w++) {
+    workers[w].join();
+  }
+
+  PrintResults();
+
+  // a trace that could not be run or checkpointed fails the whole run
+  for (size_t t = 0; t < results.size(); t++) {
+    if (!results[t].ok || !results[t].saved) {
+      return -1;
+    }
+  }
+  return 0;
+}
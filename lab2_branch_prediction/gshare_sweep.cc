@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "gshare_sweep.h"
+#include "packed_counters.h"
+
+/////////////////////////////////////////////////////////////
+// configuration
+/////////////////////////////////////////////////////////////
+
+// <a> or <a>-<b>
+static bool ParseRange(const char *spec, char **end, unsigned *lo, unsigned *hi) {
+  *lo = strtoul(spec, end, 10);
+  if (*end == spec) {
+    return false;
+  }
+  *hi = *lo;
+  if (**end == '-') {
+    const char *start = *end + 1;
+    *hi = strtoul(start, end, 10);
+    if (*end == start) {
+      return false;
+    }
+  }
+  return *lo <= *hi;
+}
+
+bool ParseGshareSweep(const char *spec, GshareSweepConfig *cfg) {
+  cfg->lanes.clear();
+  cfg->ctrBits = 3;
+
+  char *end;
+  unsigned sizeLo, sizeHi;
+  if (!ParseRange(spec, &end, &sizeLo, &sizeHi)) {
+    return false;
+  }
+  bool ownHistory = true;
+  unsigned histLo = 0, histHi = 0;
+  if (*end == ':') {
+    if (!ParseRange(end + 1, &end, &histLo, &histHi)) {
+      return false;
+    }
+    ownHistory = false;
+  }
+  if (*end == ',') {
+    if (end[1] != 'c') {
+      return false;
+    }
+    cfg->ctrBits = strtoul(end + 2, &end, 10);
+  }
+  if (*end != '\0' || cfg->ctrBits < 1 || cfg->ctrBits > 8 || sizeLo < 1 || sizeHi > 24 || histHi > 32) {
+    return false;
+  }
+
+  for (unsigned s = sizeLo; s <= sizeHi; s++) {
+    unsigned lo = ownHistory ? s : histLo;
+    unsigned hi = ownHistory ? s : histHi;
+    for (unsigned h = lo; h <= hi; h++) {
+      if (cfg->lanes.size() == GSHARE_SWEEP_MAX_LANES) {
+        return false;
+      }
+      GshareSweepLane lane;
+      lane.logSize = s;
+      lane.histBits = h;
+      cfg->lanes.push_back(lane);
+    }
+  }
+  return true;
+}
+
+std::string GshareSweepName(const GshareSweepConfig &cfg, size_t lane) {
+  char name[64];
+  snprintf(name, sizeof(name), "gshare-%u-h%u-c%u", 1u << cfg.lanes[lane].logSize, cfg.lanes[lane].histBits,
+           cfg.ctrBits);
+  return name;
+}
+
+/////////////////////////////////////////////////////////////
+// lanes
+/////////////////////////////////////////////////////////////
+
+GshareSweep::GshareSweep(const GshareSweepConfig &cfg)
+    : ctrBits(cfg.ctrBits), history(0), mispred(cfg.lanes.size(), 0) {
+  numLanes = (cfg.lanes.size() + GSHARE_SWEEP_VECTOR - 1) / GSHARE_SWEEP_VECTOR * GSHARE_SWEEP_VECTOR;
+
+  UINT32 total = 0;
+  for (size_t l = 0; l < numLanes; l++) {
+    // padding lanes get one private counter of their own
+    unsigned logSize = l < cfg.lanes.size() ? cfg.lanes[l].logSize : 0;
+    unsigned histBits = l < cfg.lanes.size() ? cfg.lanes[l].histBits : 0;
+    offset.push_back(total);
+    sizeMask.push_back((1u << logSize) - 1);
+    histMask.push_back(histBits == 32 ? ~0u : (1u << histBits) - 1);
+    total += 1u << logSize;
+  }
+  // the gather reads 4 bytes from the address of every counter
+  counters.assign(total + 3, WEAK_NOT_TAKEN(ctrBits));
+}
+
+void GshareSweep::Process(const BranchRecord *recs, size_t count) {
+  const UINT32 weakNotTaken = WEAK_NOT_TAKEN(ctrBits);
+  const UINT32 ctrMax = (1u << ctrBits) - 1;
+  uint8_t *table = &counters[0];
+
+#if defined(__AVX2__)
+  const size_t numVec = numLanes / GSHARE_SWEEP_VECTOR;
+  __m256i off[GSHARE_SWEEP_MAX_LANES / GSHARE_SWEEP_VECTOR];
+  __m256i sm[GSHARE_SWEEP_MAX_LANES / GSHARE_SWEEP_VECTOR];
+  __m256i hm[GSHARE_SWEEP_MAX_LANES / GSHARE_SWEEP_VECTOR];
+  __m256i miss[GSHARE_SWEEP_MAX_LANES / GSHARE_SWEEP_VECTOR];
+  for (size_t v = 0; v < numVec; v++) {
+    off[v] = _mm256_loadu_si256((const __m256i *)&offset[v * GSHARE_SWEEP_VECTOR]);
+    sm[v] = _mm256_loadu_si256((const __m256i *)&sizeMask[v * GSHARE_SWEEP_VECTOR]);
+    hm[v] = _mm256_loadu_si256((const __m256i *)&histMask[v * GSHARE_SWEEP_VECTOR]);
+    miss[v] = _mm256_setzero_si256();
+  }
+  const __m256i byteMask = _mm256_set1_epi32(0xff);
+  const __m256i weak = _mm256_set1_epi32(weakNotTaken);
+  const __m256i top = _mm256_set1_epi32(ctrMax);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i ones = _mm256_set1_epi32(-1);
+  alignas(32) UINT32 idx[GSHARE_SWEEP_VECTOR];
+  alignas(32) UINT32 next[GSHARE_SWEEP_VECTOR];
+
+  for (size_t i = 0; i < count; i++) {
+    const BranchRecord &rec = recs[i];
+    if (rec.opType != OPTYPE_BRANCH_COND) {
+      continue;
+    }
+    const __m256i pc = _mm256_set1_epi32(rec.PC);
+    const __m256i hist = _mm256_set1_epi32(history);
+    const __m256i taken = rec.taken ? ones : zero;
+
+    for (size_t v = 0; v < numVec; v++) {
+      __m256i ix = _mm256_add_epi32(off[v], _mm256_and_si256(_mm256_xor_si256(pc, _mm256_and_si256(hist, hm[v])), sm[v]));
+      __m256i ctr = _mm256_and_si256(_mm256_i32gather_epi32((const int *)table, ix, 1), byteMask);
+
+      // -1 in the lanes that mispredict
+      __m256i predTaken = _mm256_cmpgt_epi32(ctr, weak);
+      miss[v] = _mm256_sub_epi32(miss[v], _mm256_xor_si256(predTaken, taken));
+
+      // -1 where the counter moves up / down
+      __m256i up = _mm256_andnot_si256(_mm256_cmpeq_epi32(ctr, top), taken);
+      __m256i down = _mm256_andnot_si256(_mm256_or_si256(_mm256_cmpeq_epi32(ctr, zero), taken), ones);
+      __m256i nx = _mm256_add_epi32(_mm256_sub_epi32(ctr, up), down);
+
+      _mm256_store_si256((__m256i *)idx, ix);
+      _mm256_store_si256((__m256i *)next, nx);
+      for (unsigned j = 0; j < GSHARE_SWEEP_VECTOR; j++) {
+        table[idx[j]] = (uint8_t)next[j];
+      }
+    }
+    history = (history << 1) | (rec.taken ? 1 : 0);
+  }
+
+  // a chunk has far fewer than 2^32 branches, the lane counts cannot wrap
+  for (size_t v = 0; v < numVec; v++) {
+    alignas(32) UINT32 lanes[GSHARE_SWEEP_VECTOR];
+    _mm256_store_si256((__m256i *)lanes, miss[v]);
+    for (unsigned j = 0; j < GSHARE_SWEEP_VECTOR; j++) {
+      size_t l = v * GSHARE_SWEEP_VECTOR + j;
+      if (l < mispred.size()) {
+        mispred[l] += lanes[j];
+      }
+    }
+  }
+#else
+  for (size_t i = 0; i < count; i++) {
+    const BranchRecord &rec = recs[i];
+    if (rec.opType != OPTYPE_BRANCH_COND) {
+      continue;
+    }
+    for (size_t l = 0; l < mispred.size(); l++) {
+      uint8_t &ctr = table[offset[l] + ((rec.PC ^ (history & histMask[l])) & sizeMask[l])];
+      mispred[l] += (ctr > weakNotTaken) != rec.taken;
+      ctr += (rec.taken && ctr != ctrMax) - (!rec.taken && ctr != 0);
+    }
+    history = (history << 1) | (rec.taken ? 1 : 0);
+  }
+#endif
+}
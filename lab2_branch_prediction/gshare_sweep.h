@@ -0,0 +1,77 @@
+#ifndef _GSHARE_SWEEP_H_
+#define _GSHARE_SWEEP_H_
+
+#include <string>
+#include <vector>
+
+#include "bpsim.h"
+
+/////////////////////////////////////////////////////////////
+// single pass gshare sweep
+/////////////////////////////////////////////////////////////
+/*
+N independent gshare predictors (lanes) that share one global history
+register and are all trained from the same pass over a trace, for
+history sensitivity curves and table size sweeps.
+
+  <log sizes>[:<history lengths>][,c<ctr bits>]
+
+each list is a value or a range a-b; every size is combined with every
+history length (the log size itself when none are given), counters are
+3 bits by default. 15:0-15 sweeps the history of the 32K-entry
+openend, 10-17 the gshare-<entries>-h<log entries> points of the grid.
+Lane i predicts exactly like Gshare<LogSize, HistBits, CtrBits,
+PcXorHistory<0>> (predictor_templates.h) and is reported under the
+same name, gshare-<entries>-h<hist>-c<ctr bits>.
+
+The counters of all lanes are one byte array (one byte per counter
+instead of packed words, so they can be gathered), lane i at
+offset[i]. Per branch, the lanes are processed GSHARE_SWEEP_VECTOR at
+a time: index, gather, prediction, mispredict count and saturating
+update are AVX2 (-mavx2); the new counters are written back one lane
+at a time, AVX2 has no scatter. The lanes own disjoint parts of the
+array, so the write-backs never collide. Other hosts run the same
+steps lane by lane.
+*/
+
+#define GSHARE_SWEEP_MAX_LANES 64
+#define GSHARE_SWEEP_VECTOR 8
+
+struct GshareSweepLane {
+  unsigned logSize;
+  unsigned histBits;
+};
+
+struct GshareSweepConfig {
+  std::vector<GshareSweepLane> lanes;
+  unsigned ctrBits;
+};
+
+// false on a syntax error or more than GSHARE_SWEEP_MAX_LANES lanes
+bool ParseGshareSweep(const char *spec, GshareSweepConfig *cfg);
+
+// gshare-<entries>-h<hist>-c<ctr bits>
+std::string GshareSweepName(const GshareSweepConfig &cfg, size_t lane);
+
+class GshareSweep {
+ public:
+  explicit GshareSweep(const GshareSweepConfig &cfg);
+
+  // predicts and trains every lane on the conditional branches of recs
+  void Process(const BranchRecord *recs, size_t count);
+
+  // mispredictions per lane so far
+  const std::vector<UINT64> &Mispred() const { return mispred; }
+
+ private:
+  size_t numLanes; // configured lanes, rounded up to GSHARE_SWEEP_VECTOR
+  unsigned ctrBits;
+  std::vector<UINT32> offset;
+  std::vector<UINT32> sizeMask;
+  std::vector<UINT32> histMask;
+  std::vector<uint8_t> counters;
+  UINT32 history;
+  std::vector<UINT64> mispred;
+};
+
+#endif
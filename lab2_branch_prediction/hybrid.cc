@@ -0,0 +1,428 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <deque>
+#include <string>
+
+#include "hybrid.h"
+
+/////////////////////////////////////////////////////////////
+// configuration
+/////////////////////////////////////////////////////////////
+
+// child of a chooser node, >= 0 is a node, < 0 is component ~child
+struct HybridNode {
+  int left;
+  int right;
+};
+
+struct HybridConfig {
+  bool used;
+  int registryIndex;
+  unsigned logChooser;
+  std::vector<int> partIndex;
+  std::vector<PredictorDesc> parts;
+  std::vector<HybridNode> nodes;
+
+  // components with InitAt run on their own State at partOffset in one
+  // block of blockSize bytes per thread, the others on their registered tables
+  std::vector<size_t> partOffset;
+  size_t blockSize;
+  size_t blockAlign;
+};
+
+// written while registering, before any worker thread starts
+static HybridConfig hybridConfig[HYBRID_MAX_SLOTS];
+
+struct HybridState {
+  std::vector<uint64_t> chooser;
+  bool partPred[HYBRID_MAX_PARTS];
+  std::vector<char> storage;
+  char *block;
+
+  // with delayed updates, one record per component for every branch in
+  // flight, oldest branch first
+  std::deque<InFlightBranch> inFlight;
+};
+
+static thread_local HybridState hybridState[HYBRID_MAX_SLOTS];
+
+static int BuildTree(HybridConfig &cfg, int lo, int hi) {
+  if (hi - lo == 1) {
+    return ~lo;
+  }
+
+  int n = cfg.nodes.size();
+  cfg.nodes.push_back(HybridNode());
+  int mid = (lo + hi) / 2;
+  int left = BuildTree(cfg, lo, mid);
+  int right = BuildTree(cfg, mid, hi);
+  cfg.nodes[n].left = left;
+  cfg.nodes[n].right = right;
+  return n;
+}
+
+/////////////////////////////////////////////////////////////
+// prediction
+/////////////////////////////////////////////////////////////
+
+static inline unsigned Chooser(uint64_t row, int node) {
+  return (row >> (2 * node)) & 0x3;
+}
+
+static inline UINT32 ChooserIndex(const HybridConfig &cfg, UINT32 PC) {
+  return (PC ^ (PC >> cfg.logChooser)) & ((1u << cfg.logChooser) - 1);
+}
+
+// prediction of the subtree at child
+static bool Choose(const HybridConfig &cfg, const HybridState &st, uint64_t row, int child) {
+  while (child >= 0) {
+    const HybridNode &node = cfg.nodes[child];
+    child = (Chooser(row, child) >> 1) ? node.right : node.left;
+  }
+  return st.partPred[~child];
+}
+
+// trains the choosers below child, returns the subtree prediction
+static bool Train(const HybridConfig &cfg, const HybridState &st, uint64_t &row, int child, bool resolveDir) {
+  if (child < 0) {
+    return st.partPred[~child];
+  }
+
+  const HybridNode &node = cfg.nodes[child];
+  bool left = Train(cfg, st, row, node.left, resolveDir);
+  bool right = Train(cfg, st, row, node.right, resolveDir);
+  unsigned sel = Chooser(row, child);
+
+  if (left != right) {
+    // bias toward the side that was right
+    unsigned next = sel;
+    if (right == resolveDir && sel < 3) {
+      next++;
+    }
+    else if (left == resolveDir && sel > 0) {
+      next--;
+    }
+    row = (row & ~(0x3ull << (2 * child))) | ((uint64_t)next << (2 * child));
+  }
+  return (sel >> 1) ? right : left;
+}
+
+static void HybridInit(unsigned slot) {
+  const HybridConfig &cfg = hybridConfig[slot];
+  HybridState &st = hybridState[slot];
+
+  // every chooser weakly selects the left subtree (01)
+  uint64_t row = 0;
+  for (size_t n = 0; n < cfg.nodes.size(); n++) {
+    row |= 0x1ull << (2 * n);
+  }
+  st.chooser.assign((size_t)1 << cfg.logChooser, row);
+  st.inFlight.clear();
+
+  st.storage.resize(cfg.blockSize + cfg.blockAlign);
+  uintptr_t base = (uintptr_t)&st.storage[0];
+  st.block = &st.storage[0] + ((cfg.blockAlign - base % cfg.blockAlign) % cfg.blockAlign);
+
+  for (size_t p = 0; p < cfg.parts.size(); p++) {
+    if (cfg.parts[p].InitAt != NULL) {
+      cfg.parts[p].InitAt(st.block + cfg.partOffset[p]);
+    }
+    else {
+      cfg.parts[p].Init();
+    }
+  }
+}
+
+static bool HybridGet(unsigned slot, UINT32 PC) {
+  const HybridConfig &cfg = hybridConfig[slot];
+  HybridState &st = hybridState[slot];
+
+  for (size_t p = 0; p < cfg.parts.size(); p++) {
+    const PredictorDesc &part = cfg.parts[p];
+    st.partPred[p] = part.GetAt != NULL ? part.GetAt(st.block + cfg.partOffset[p], PC) : part.Get(PC);
+  }
+  return Choose(cfg, st, st.chooser[ChooserIndex(cfg, PC)], 0);
+}
+
+static void HybridUpdate(unsigned slot, UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
+  const HybridConfig &cfg = hybridConfig[slot];
+  HybridState &st = hybridState[slot];
+
+  Train(cfg, st, st.chooser[ChooserIndex(cfg, PC)], 0, resolveDir);
+
+  for (size_t p = 0; p < cfg.parts.size(); p++) {
+    const PredictorDesc &part = cfg.parts[p];
+    if (part.UpdateAt != NULL) {
+      part.UpdateAt(st.block + cfg.partOffset[p], PC, resolveDir, st.partPred[p], branchTarget);
+    }
+    else {
+      part.Update(PC, resolveDir, st.partPred[p], branchTarget);
+    }
+  }
+}
+
+// sets the history of component p after the youngest branch to dir
+static void RepairPart(const HybridConfig &cfg, HybridState &st, size_t p, bool dir) {
+  const PredictorDesc &part = cfg.parts[p];
+  const InFlightBranch &pb = st.inFlight[st.inFlight.size() - cfg.parts.size() + p];
+  if (part.PipeRepairAt != NULL) {
+    part.PipeRepairAt(st.block + cfg.partOffset[p], pb, dir);
+  }
+  else {
+    part.PipeRepair(pb, dir);
+  }
+}
+
+static bool HybridPipePredict(unsigned slot, UINT32 PC, InFlightBranch *b, bool spec) {
+  const HybridConfig &cfg = hybridConfig[slot];
+  HybridState &st = hybridState[slot];
+
+  for (size_t p = 0; p < cfg.parts.size(); p++) {
+    const PredictorDesc &part = cfg.parts[p];
+    st.inFlight.push_back(InFlightBranch());
+    InFlightBranch &pb = st.inFlight.back();
+    pb.PC = PC;
+    pb.branchTarget = b->branchTarget;
+    pb.taken = b->taken;
+    pb.predDir = part.PipePredictAt != NULL ? part.PipePredictAt(st.block + cfg.partOffset[p], PC, &pb, spec)
+                                            : part.PipePredict(PC, &pb, spec);
+    st.partPred[p] = pb.predDir;
+  }
+  bool predDir = Choose(cfg, st, st.chooser[ChooserIndex(cfg, PC)], 0);
+
+  // the front end follows the hybrid, components that disagree take its direction
+  if (spec) {
+    for (size_t p = 0; p < cfg.parts.size(); p++) {
+      if (st.partPred[p] != predDir) {
+        RepairPart(cfg, st, p, predDir);
+      }
+    }
+  }
+  return predDir;
+}
+
+// repairs the components of the youngest branch
+static void HybridPipeRepair(unsigned slot, const InFlightBranch &b, bool resolveDir) {
+  const HybridConfig &cfg = hybridConfig[slot];
+  HybridState &st = hybridState[slot];
+
+  for (size_t p = 0; p < cfg.parts.size(); p++) {
+    RepairPart(cfg, st, p, resolveDir);
+  }
+}
+
+// trains the choosers and commits the components of the oldest branch
+static void HybridPipeCommit(unsigned slot, const InFlightBranch &b, bool resolveDir, bool spec) {
+  const HybridConfig &cfg = hybridConfig[slot];
+  HybridState &st = hybridState[slot];
+
+  for (size_t p = 0; p < cfg.parts.size(); p++) {
+    st.partPred[p] = st.inFlight[p].predDir;
+  }
+  Train(cfg, st, st.chooser[ChooserIndex(cfg, b.PC)], 0, resolveDir);
+
+  for (size_t p = 0; p < cfg.parts.size(); p++) {
+    const PredictorDesc &part = cfg.parts[p];
+    if (part.PipeCommitAt != NULL) {
+      part.PipeCommitAt(st.block + cfg.partOffset[p], st.inFlight.front(), resolveDir, spec);
+    }
+    else {
+      part.PipeCommit(st.inFlight.front(), resolveDir, spec);
+    }
+    st.inFlight.pop_front();
+  }
+}
+
+// chooser rows, then every component's checkpoint prefixed by its length
+// (the bytes of its State for the ones run on the hybrid's block)
+static void HybridSave(unsigned slot, PredictorState *out) {
+  const HybridConfig &cfg = hybridConfig[slot];
+  HybridState &st = hybridState[slot];
+
+  out->append((const char *)&st.chooser[0], st.chooser.size() * sizeof(uint64_t));
+  for (size_t p = 0; p < cfg.parts.size(); p++) {
+    PredictorState part;
+    if (cfg.parts[p].InitAt != NULL) {
+      part.assign(st.block + cfg.partOffset[p], cfg.parts[p].stateSize);
+    }
+    else if (cfg.parts[p].Save != NULL) {
+      cfg.parts[p].Save(&part);
+    }
+    SaveState(out, (UINT64)part.size());
+    out->append(part);
+  }
+}
+
+static bool HybridRestore(unsigned slot, const PredictorState &in) {
+  const HybridConfig &cfg = hybridConfig[slot];
+  HybridState &st = hybridState[slot];
+
+  size_t pos = st.chooser.size() * sizeof(uint64_t);
+  if (pos > in.size()) {
+    return false;
+  }
+  memcpy(&st.chooser[0], in.data(), pos);
+
+  for (size_t p = 0; p < cfg.parts.size(); p++) {
+    const PredictorDesc &part = cfg.parts[p];
+    UINT64 len;
+    if (!RestoreState(in, &pos, &len) || pos + len > in.size()) {
+      return false;
+    }
+    if (part.InitAt != NULL) {
+      if (len != part.stateSize) {
+        return false;
+      }
+      memcpy(st.block + cfg.partOffset[p], in.data() + pos, len);
+    }
+    else if (part.Restore == NULL || !part.Restore(in.substr(pos, len))) {
+      return false;
+    }
+    pos += len;
+  }
+  return pos == in.size();
+}
+
+template <unsigned Slot>
+struct HybridSlot {
+  static void Init() { HybridInit(Slot); }
+  static bool Get(UINT32 PC) { return HybridGet(Slot, PC); }
+  static void Update(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
+    HybridUpdate(Slot, PC, resolveDir, predDir, branchTarget);
+  }
+  static void Save(PredictorState *out) { HybridSave(Slot, out); }
+  static bool Restore(const PredictorState &in) { return HybridRestore(Slot, in); }
+  static bool PipePredict(UINT32 PC, InFlightBranch *b, bool spec) { return HybridPipePredict(Slot, PC, b, spec); }
+  static void PipeRepair(const InFlightBranch &b, bool resolveDir) { HybridPipeRepair(Slot, b, resolveDir); }
+  static void PipeCommit(const InFlightBranch &b, bool resolveDir, bool spec) {
+    HybridPipeCommit(Slot, b, resolveDir, spec);
+  }
+};
+
+struct HybridSlotFns {
+  void (*Init)();
+  bool (*Get)(UINT32);
+  void (*Update)(UINT32, bool, bool, UINT32);
+  void (*Save)(PredictorState *);
+  bool (*Restore)(const PredictorState &);
+  bool (*PipePredict)(UINT32, InFlightBranch *, bool);
+  void (*PipeRepair)(const InFlightBranch &, bool);
+  void (*PipeCommit)(const InFlightBranch &, bool, bool);
+};
+
+#define HYBRID_SLOT(k)                                                                        \
+  {                                                                                           \
+    HybridSlot<k>::Init, HybridSlot<k>::Get, HybridSlot<k>::Update, HybridSlot<k>::Save,       \
+        HybridSlot<k>::Restore, HybridSlot<k>::PipePredict, HybridSlot<k>::PipeRepair,        \
+        HybridSlot<k>::PipeCommit                                                             \
+  }
+
+static const HybridSlotFns hybridSlotFns[HYBRID_MAX_SLOTS] = {
+  HYBRID_SLOT(0), HYBRID_SLOT(1), HYBRID_SLOT(2), HYBRID_SLOT(3),
+  HYBRID_SLOT(4), HYBRID_SLOT(5), HYBRID_SLOT(6), HYBRID_SLOT(7),
+};
+
+/////////////////////////////////////////////////////////////
+// registration
+/////////////////////////////////////////////////////////////
+
+int RegisterHybrid(const char *spec) {
+  if (strncmp(spec, "hybrid:", 7) != 0) {
+    return -1;
+  }
+
+  unsigned slot = 0;
+  while (slot < HYBRID_MAX_SLOTS && hybridConfig[slot].used) {
+    slot++;
+  }
+  if (slot == HYBRID_MAX_SLOTS) {
+    fprintf(stderr, "hybrid: at most %d hybrids per run\n", HYBRID_MAX_SLOTS);
+    return -1;
+  }
+
+  HybridConfig cfg;
+  cfg.used = true;
+  cfg.logChooser = HYBRID_DEFAULT_LOG_CHOOSER;
+
+  std::string parts(spec + 7);
+  size_t at = parts.find('@');
+  if (at != std::string::npos) {
+    cfg.logChooser = atoi(parts.c_str() + at + 1);
+    parts.resize(at);
+    if (cfg.logChooser < 1 || cfg.logChooser > 24) {
+      fprintf(stderr, "hybrid: bad chooser size in %s\n", spec);
+      return -1;
+    }
+  }
+
+  size_t start = 0;
+  while (start <= parts.size()) {
+    size_t end = parts.find('+', start);
+    if (end == std::string::npos) {
+      end = parts.size();
+    }
+    std::string name = parts.substr(start, end - start);
+    int idx = FindPredictor(name.c_str());
+    if (idx < 0) {
+      fprintf(stderr, "hybrid: unknown component %s in %s\n", name.c_str(), spec);
+      return -1;
+    }
+    cfg.partIndex.push_back(idx);
+    start = end + 1;
+  }
+
+  if (cfg.partIndex.size() < 2 || cfg.partIndex.size() > HYBRID_MAX_PARTS) {
+    fprintf(stderr, "hybrid: %s needs 2 to %d components\n", spec, HYBRID_MAX_PARTS);
+    return -1;
+  }
+  for (size_t p = 0; p < cfg.partIndex.size(); p++) {
+    cfg.parts.push_back(PredictorRegistry()[cfg.partIndex[p]]);
+  }
+  BuildTree(cfg, 0, cfg.partIndex.size());
+
+  // one State per component that can run on caller-owned state, each aligned
+  // for its own tables; only the rest drive (and share) registered tables
+  std::vector<int> shared;
+  bool pipelined = true;
+  cfg.blockSize = 0;
+  cfg.blockAlign = 1;
+  for (size_t p = 0; p < cfg.parts.size(); p++) {
+    const PredictorDesc &part = cfg.parts[p];
+    if (part.InitAt == NULL) {
+      cfg.partOffset.push_back(0);
+      shared.push_back(cfg.partIndex[p]);
+      pipelined = pipelined && part.PipePredict != NULL;
+      continue;
+    }
+    pipelined = pipelined && part.PipePredictAt != NULL;
+    cfg.blockSize = (cfg.blockSize + part.stateAlign - 1) / part.stateAlign * part.stateAlign;
+    cfg.partOffset.push_back(cfg.blockSize);
+    cfg.blockSize += part.stateSize;
+    if (part.stateAlign > cfg.blockAlign) {
+      cfg.blockAlign = part.stateAlign;
+    }
+  }
+
+  UINT64 storageBits = ((UINT64)2 * cfg.nodes.size()) << cfg.logChooser;
+  for (size_t p = 0; p < cfg.parts.size(); p++) {
+    storageBits += cfg.parts[p].storageBits;
+  }
+
+  cfg.registryIndex = PredictorRegistry().size();
+  hybridConfig[slot] = cfg;
+
+  const HybridSlotFns &fns = hybridSlotFns[slot];
+  PredictorDesc &desc = RegisterPredictor(strdup(spec), fns.Init, fns.Get, fns.Update, storageBits);
+  desc.parts = shared;
+  desc.Save = fns.Save;
+  desc.Restore = fns.Restore;
+  // delayed updates if every component has them
+  if (pipelined) {
+    desc.PipePredict = fns.PipePredict;
+    desc.PipeRepair = fns.PipeRepair;
+    desc.PipeCommit = fns.PipeCommit;
+  }
+  return cfg.registryIndex;
+}
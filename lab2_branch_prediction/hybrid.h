@@ -0,0 +1,50 @@
+#ifndef _HYBRID_H_
+#define _HYBRID_H_
+
+#include <vector>
+
+#include "bpsim.h"
+
+/////////////////////////////////////////////////////////////
+// hybrid predictors
+/////////////////////////////////////////////////////////////
+/*
+Combines registered predictors at run time:
+
+  hybrid:<a>+<b>[+<c>...][@<log2 chooser entries>]
+
+Two components are combined through a tournament chooser table of
+2-bit counters (MSB set = second component). More components form a
+binary chooser tree over the component list, each inner node choosing
+between its left and right subtree.
+All 2-bit choosers of one chooser index live in one 64-bit word, so a
+lookup reads a single word no matter how deep the tree is (at most
+HYBRID_MAX_PARTS components).
+
+Every component is updated on every branch with its own prediction.
+A chooser is trained only when its two subtrees disagree, towards the
+one that was right.
+With delayed updates (pipeline.h) the hybrid keeps one in-flight
+record per component and trains the choosers at commit. Speculative
+component histories take the hybrid's prediction, not their own. A
+hybrid has the pipeline hooks when all of its components have them.
+
+Hybrids are registered like any other predictor, using one of
+HYBRID_MAX_SLOTS preallocated Init/Get/Update slots.
+Every template component runs on its own copy of the template's State
+(InitAt/GetAt/UpdateAt in bpsim.h), laid out in one block per hybrid
+and thread, so the same predictor can be a component of several
+hybrids, twice in one hybrid, or run on its own next to them.
+Components without caller-owned state (alias-*, loop:*) drive their
+registered tables and keep the one-owner rule of
+CheckPredictorConflicts in bpsim.h.
+*/
+
+#define HYBRID_MAX_SLOTS 8
+#define HYBRID_MAX_PARTS 32
+#define HYBRID_DEFAULT_LOG_CHOOSER 12
+
+// parses spec and registers the hybrid, returns its registry index or -1
+int RegisterHybrid(const char *spec);
+
+#endif
@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <deque>
+
+#include "loop.h"
+
+/////////////////////////////////////////////////////////////
+// loop:<name> predictors
+/////////////////////////////////////////////////////////////
+
+// 64 sets x 4 ways, 14-bit tags, trip counts up to 1023
+typedef LoopTable<6, 4, 14, 10> DefaultLoopTable;
+
+struct LoopConfig {
+  bool used;
+  PredictorDesc base;
+};
+
+// written while registering, before any worker thread starts
+static LoopConfig loopConfig[LOOP_MAX_SLOTS];
+
+struct LoopState {
+  DefaultLoopTable table;
+  bool basePred;
+
+  // with delayed updates, the base predictor's record of every branch in
+  // flight (predDir is the base prediction), oldest first
+  std::deque<InFlightBranch> inFlight;
+};
+
+static thread_local LoopState loopState[LOOP_MAX_SLOTS];
+
+static void LoopInit(unsigned slot) {
+  loopState[slot].table.Init();
+  loopState[slot].inFlight.clear();
+  loopConfig[slot].base.Init();
+}
+
+static bool LoopGet(unsigned slot, UINT32 PC) {
+  LoopState &st = loopState[slot];
+  st.basePred = loopConfig[slot].base.Get(PC);
+  st.table.Lookup(PC);
+  return st.table.confident ? st.table.pred : st.basePred;
+}
+
+static void LoopUpdate(unsigned slot, UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
+  LoopState &st = loopState[slot];
+  st.table.Update(PC, resolveDir, st.basePred, branchTarget);
+  loopConfig[slot].base.Update(PC, resolveDir, st.basePred, branchTarget);
+}
+
+static bool LoopPipePredict(unsigned slot, UINT32 PC, InFlightBranch *b, bool spec) {
+  LoopState &st = loopState[slot];
+  st.inFlight.push_back(InFlightBranch());
+  InFlightBranch &base = st.inFlight.back();
+  base.PC = PC;
+  base.branchTarget = b->branchTarget;
+  base.taken = b->taken;
+  base.predDir = loopConfig[slot].base.PipePredict(PC, &base, spec);
+
+  st.table.Lookup(PC);
+  if (!st.table.confident) {
+    return base.predDir;
+  }
+  // the base history follows the loop's override
+  if (spec && st.table.pred != base.predDir) {
+    loopConfig[slot].base.PipeRepair(base, st.table.pred);
+  }
+  return st.table.pred;
+}
+
+static void LoopPipeRepair(unsigned slot, const InFlightBranch &b, bool resolveDir) {
+  loopConfig[slot].base.PipeRepair(loopState[slot].inFlight.back(), resolveDir);
+}
+
+// the loop table is looked up again and trained at commit
+static void LoopPipeCommit(unsigned slot, const InFlightBranch &b, bool resolveDir, bool spec) {
+  LoopState &st = loopState[slot];
+  const InFlightBranch &base = st.inFlight.front();
+  st.table.Lookup(b.PC);
+  st.table.Update(b.PC, resolveDir, base.predDir, b.branchTarget);
+  loopConfig[slot].base.PipeCommit(base, resolveDir, spec);
+  st.inFlight.pop_front();
+}
+
+// loop table, then the base predictor's checkpoint
+static void LoopSave(unsigned slot, PredictorState *out) {
+  SaveState(out, loopState[slot].table);
+  loopConfig[slot].base.Save(out);
+}
+
+static bool LoopRestore(unsigned slot, const PredictorState &in) {
+  size_t pos = 0;
+  return RestoreState(in, &pos, &loopState[slot].table) && loopConfig[slot].base.Restore(in.substr(pos));
+}
+
+template <unsigned Slot>
+struct LoopSlot {
+  static void Init() { LoopInit(Slot); }
+  static bool Get(UINT32 PC) { return LoopGet(Slot, PC); }
+  static void Update(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
+    LoopUpdate(Slot, PC, resolveDir, predDir, branchTarget);
+  }
+  static void Save(PredictorState *out) { LoopSave(Slot, out); }
+  static bool Restore(const PredictorState &in) { return LoopRestore(Slot, in); }
+  static bool PipePredict(UINT32 PC, InFlightBranch *b, bool spec) { return LoopPipePredict(Slot, PC, b, spec); }
+  static void PipeRepair(const InFlightBranch &b, bool resolveDir) { LoopPipeRepair(Slot, b, resolveDir); }
+  static void PipeCommit(const InFlightBranch &b, bool resolveDir, bool spec) {
+    LoopPipeCommit(Slot, b, resolveDir, spec);
+  }
+};
+
+#define LOOP_SLOT(k)                                                                                   \
+  {                                                                                                    \
+    LoopSlot<k>::Init, LoopSlot<k>::Get, LoopSlot<k>::Update, LoopSlot<k>::Save, LoopSlot<k>::Restore, \
+        LoopSlot<k>::PipePredict, LoopSlot<k>::PipeRepair, LoopSlot<k>::PipeCommit                     \
+  }
+
+static const struct {
+  void (*Init)();
+  bool (*Get)(UINT32);
+  void (*Update)(UINT32, bool, bool, UINT32);
+  void (*Save)(PredictorState *);
+  bool (*Restore)(const PredictorState &);
+  bool (*PipePredict)(UINT32, InFlightBranch *, bool);
+  void (*PipeRepair)(const InFlightBranch &, bool);
+  void (*PipeCommit)(const InFlightBranch &, bool, bool);
+} loopSlotFns[LOOP_MAX_SLOTS] = {
+  LOOP_SLOT(0), LOOP_SLOT(1), LOOP_SLOT(2), LOOP_SLOT(3),
+};
+
+int RegisterLoop(const char *spec) {
+  if (strncmp(spec, "loop:", 5) != 0) {
+    return -1;
+  }
+
+  unsigned slot = 0;
+  while (slot < LOOP_MAX_SLOTS && loopConfig[slot].used) {
+    slot++;
+  }
+  if (slot == LOOP_MAX_SLOTS) {
+    fprintf(stderr, "loop: at most %d loop predictors per run\n", LOOP_MAX_SLOTS);
+    return -1;
+  }
+
+  int baseIdx = FindPredictor(spec + 5);
+  if (baseIdx < 0) {
+    fprintf(stderr, "loop: unknown predictor %s\n", spec + 5);
+    return -1;
+  }
+  const PredictorDesc &base = PredictorRegistry()[baseIdx];
+  if (base.Save == NULL || base.Restore == NULL) {
+    fprintf(stderr, "loop: %s cannot be wrapped\n", spec + 5);
+    return -1;
+  }
+
+  loopConfig[slot].used = true;
+  loopConfig[slot].base = base;
+
+  int idx = PredictorRegistry().size();
+  PredictorDesc &desc = RegisterPredictor(strdup(spec), loopSlotFns[slot].Init, loopSlotFns[slot].Get,
+                                          loopSlotFns[slot].Update,
+                                          base.storageBits + DefaultLoopTable::kStorageBits);
+  desc.parts.push_back(baseIdx);
+  desc.Save = loopSlotFns[slot].Save;
+  desc.Restore = loopSlotFns[slot].Restore;
+  if (base.PipePredict != NULL) {
+    desc.PipePredict = loopSlotFns[slot].PipePredict;
+    desc.PipeRepair = loopSlotFns[slot].PipeRepair;
+    desc.PipeCommit = loopSlotFns[slot].PipeCommit;
+  }
+  return idx;
+}
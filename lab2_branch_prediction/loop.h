@@ -0,0 +1,163 @@
+#ifndef _LOOP_H_
+#define _LOOP_H_
+
+#include <string.h>
+
+#include "bpsim.h"
+
+/////////////////////////////////////////////////////////////
+// loop predictor
+/////////////////////////////////////////////////////////////
+/*
+Learns the trip count of loop branches and overrides a base predictor
+on the last iteration (Seznec, L-TAGE).
+
+  loop:<name>
+
+wraps any registered predictor. The loop table has 2^LogSets sets of
+Ways entries of
+
+  tag        TagBits of the PC
+  tripCount  executions per loop instance, exit included (0 = not learned)
+  iter       executions so far in the current instance
+  conf       instances in a row that ended at tripCount
+  age        replacement priority
+  dir        direction of the body iterations, the exit goes the other way
+
+An entry is allocated when the base predictor mispredicts a backward
+branch (branchTarget < PC) and a way of the set has age 0, otherwise
+the ages of the set are decremented. Once conf reaches
+LOOP_CONF_THRESHOLD the entry predicts dir, and !dir on the execution
+where iter + 1 == tripCount; until then the base prediction is used.
+A loop exit at another count, or an instance running past tripCount,
+frees the entry.
+The base predictor is trained on every branch with its own
+prediction, as in a hybrid.
+With delayed updates (pipeline.h) the base predictor is pipelined as
+usual, while the loop table is looked up again and trained at commit,
+so its iteration counts only see committed branches.
+*/
+
+#define LOOP_MAX_SLOTS 4
+#define LOOP_CONF_MAX 7
+#define LOOP_CONF_THRESHOLD 3
+#define LOOP_AGE_MAX 255
+
+template <unsigned LogSets, unsigned Ways, unsigned TagBits, unsigned IterBits>
+struct LoopTable {
+  static_assert(TagBits <= 16 && IterBits <= 16, "tags and counts are stored in 16 bits");
+
+  static const UINT32 kSets = 1u << LogSets;
+  static const UINT32 kTagMask = (1u << TagBits) - 1;
+  static const UINT32 kIterMax = (1u << IterBits) - 1;
+  static const UINT64 kStorageBits = (UINT64)kSets * Ways * (TagBits + 2 * IterBits + 3 + 8 + 1);
+
+  struct Entry {
+    uint16_t tag;
+    uint16_t tripCount;
+    uint16_t iter;
+    uint8_t conf;
+    uint8_t age;
+    bool dir;
+  };
+
+  Entry entries[kSets][Ways];
+
+  // lookup of the last predicted branch, reused by Update
+  UINT32 lookupPC;
+  int hitWay;
+  bool confident;
+  bool pred;
+
+  static inline UINT32 Set(UINT32 PC) { return PC & (kSets - 1); }
+  static inline UINT32 Tag(UINT32 PC) { return (PC >> LogSets) & kTagMask; }
+
+  void Init() {
+    memset(entries, 0, sizeof(entries));
+    lookupPC = 0;
+    hitWay = -1;
+    confident = false;
+    pred = false;
+  }
+
+  void Lookup(UINT32 PC) {
+    lookupPC = PC;
+    hitWay = -1;
+    confident = false;
+
+    Entry *set = entries[Set(PC)];
+    for (unsigned w = 0; w < Ways; w++) {
+      if (set[w].age > 0 && set[w].tag == Tag(PC)) {
+        hitWay = w;
+        const Entry &e = set[w];
+        confident = e.conf >= LOOP_CONF_THRESHOLD && e.tripCount > 0;
+        pred = (UINT32)e.iter + 1 == e.tripCount ? !e.dir : e.dir;
+        return;
+      }
+    }
+  }
+
+  void Update(UINT32 PC, bool resolveDir, bool basePred, UINT32 branchTarget) {
+    if (lookupPC != PC) {
+      Lookup(PC);
+    }
+
+    Entry *set = entries[Set(PC)];
+    if (hitWay < 0) {
+      // learn backward branches the base predictor gets wrong
+      if (basePred == resolveDir || branchTarget >= PC) {
+        return;
+      }
+      for (unsigned w = 0; w < Ways; w++) {
+        if (set[w].age == 0) {
+          Entry &e = set[w];
+          e.tag = Tag(PC);
+          e.tripCount = 0;
+          e.iter = 0;
+          e.conf = 0;
+          e.age = LOOP_AGE_MAX;
+          e.dir = !resolveDir;
+          return;
+        }
+      }
+      for (unsigned w = 0; w < Ways; w++) {
+        set[w].age--;
+      }
+      return;
+    }
+
+    Entry &e = set[hitWay];
+    if (confident && pred != resolveDir) {
+      e.age = 0;
+      return;
+    }
+    if (confident && basePred != resolveDir && e.age < LOOP_AGE_MAX) {
+      e.age++;
+    }
+
+    e.iter++;
+    if (resolveDir != e.dir) {
+      // loop exit
+      if (e.tripCount == e.iter) {
+        if (e.conf < LOOP_CONF_MAX) {
+          e.conf++;
+        }
+      }
+      else if (e.tripCount == 0) {
+        e.tripCount = e.iter;
+      }
+      else {
+        e.age = 0;
+      }
+      e.iter = 0;
+    }
+    else if ((e.tripCount > 0 && e.iter >= e.tripCount) || e.iter == kIterMax) {
+      e.age = 0;
+    }
+  }
+};
+
+// parses loop:<name> and registers it, returns its registry index or -1
+int RegisterLoop(const char *spec);
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef _PACKED_COUNTERS_H_
+#define _PACKED_COUNTERS_H_
+
+#include "utils.h"
+
+/////////////////////////////////////////////////////////////
+// packed saturating counters
+/////////////////////////////////////////////////////////////
+/*
+Size counters of Bits bits packed into 64-bit words.
+A counter never straddles two words, so a word holds 64 / Bits
+counters (32 2-bit, 21 3-bit or 16 4-bit counters).
+Update() saturates without branches on the direction or the counter
+value.
+The struct has no constructor so it can be a thread_local table,
+call Fill() before use.
+*/
+
+// weakly not taken state of a Bits wide counter (01, 011, ...)
+#define WEAK_NOT_TAKEN(Bits) ((1u << ((Bits) - 1)) - 1)
+
+template <unsigned Bits, UINT32 Size>
+struct PackedCounters {
+  static_assert(Bits >= 1 && Bits <= 8, "counter width must be 1..8 bits");
+
+  static const unsigned kBits = Bits;
+  static const unsigned kPerWord = 64 / Bits;
+  static const UINT32 kWords = (Size + kPerWord - 1) / kPerWord;
+  static const uint64_t kFieldMask = (1ull << Bits) - 1;
+  static const UINT64 kBytes = (UINT64)kWords * sizeof(uint64_t);
+
+  uint64_t words[kWords];
+
+  // sets every counter to value
+  void Fill(unsigned value) {
+    uint64_t word = 0;
+    for (unsigned i = 0; i < kPerWord; i++) {
+      word |= ((uint64_t)value & kFieldMask) << (i * Bits);
+    }
+    for (UINT32 i = 0; i < kWords; i++) {
+      words[i] = word;
+    }
+  }
+
+  inline unsigned Get(UINT32 i) const {
+    return (words[i / kPerWord] >> ((i % kPerWord) * Bits)) & kFieldMask;
+  }
+
+  inline void Set(UINT32 i, unsigned value) {
+    uint64_t &word = words[i / kPerWord];
+    unsigned shift = (i % kPerWord) * Bits;
+    word = (word & ~(kFieldMask << shift)) | (((uint64_t)value & kFieldMask) << shift);
+  }
+
+  // MSB of the counter
+  inline bool Taken(UINT32 i) const {
+    return (words[i / kPerWord] >> ((i % kPerWord) * Bits + Bits - 1)) & 0x1;
+  }
+
+  // saturating increment if resolveDir is taken, decrement otherwise
+  inline void Update(UINT32 i, bool resolveDir) {
+    uint64_t &word = words[i / kPerWord];
+    unsigned shift = (i % kPerWord) * Bits;
+    uint64_t state = (word >> shift) & kFieldMask;
+
+    uint64_t up = (uint64_t)resolveDir & (uint64_t)(state != kFieldMask);
+    uint64_t down = (uint64_t)!resolveDir & (uint64_t)(state != 0);
+    uint64_t next = state + up - down;
+
+    word ^= (state ^ next) << shift;
+  }
+};
+
+#endif
@@ -0,0 +1,409 @@
+#ifndef _PERCEPTRON_H_
+#define _PERCEPTRON_H_
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "utils.h"
+#include "predictor_state.h"
+
+/////////////////////////////////////////////////////////////
+// perceptron kernels
+/////////////////////////////////////////////////////////////
+/*
+Weights are int8 vectors and inputs are int8 vectors of +1/-1
+(taken/not taken) with x[0] = +1 for the bias weight.
+Vectors are padded with zero inputs to a multiple of
+PERCEPTRON_VECTOR bytes; padded weights are never trained, so they
+stay zero and add nothing to the dot product.
+Weights saturate at -127/127 so that negating one never overflows.
+
+The kernels use AVX2 when the compiler targets it (-mavx2), SSE2
+otherwise, and plain C on other hosts.
+*/
+
+#define PERCEPTRON_VECTOR 32
+
+// sum of w[i] * x[i], n is a multiple of PERCEPTRON_VECTOR
+static inline int PerceptronDot(const int8_t *w, const int8_t *x, unsigned n) {
+#if defined(__AVX2__)
+  const __m256i ones8 = _mm256_set1_epi8(1);
+  const __m256i ones16 = _mm256_set1_epi16(1);
+  __m256i acc = _mm256_setzero_si256();
+  for (unsigned i = 0; i < n; i += 32) {
+    __m256i wv = _mm256_load_si256((const __m256i *)(w + i));
+    __m256i xv = _mm256_load_si256((const __m256i *)(x + i));
+    // w * sign(x), then widen pairwise to 16 and 32 bits
+    __m256i prod = _mm256_sign_epi8(wv, xv);
+    acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(ones8, prod), ones16));
+  }
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum);
+#elif defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i bias = _mm_set1_epi8((char)0x80);
+  __m128i acc = _mm_setzero_si128();
+  for (unsigned i = 0; i < n; i += 16) {
+    __m128i wv = _mm_load_si128((const __m128i *)(w + i));
+    __m128i xv = _mm_load_si128((const __m128i *)(x + i));
+    // negate w where x is -1 (padding has x = 0 and w = 0)
+    __m128i neg = _mm_cmpgt_epi8(zero, xv);
+    __m128i prod = _mm_sub_epi8(_mm_xor_si128(wv, neg), neg);
+    // sum of unsigned (prod + 128) per 8 bytes, the bias is removed below
+    acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_xor_si128(prod, bias), zero));
+  }
+  int sum = _mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(acc, acc));
+  return sum - 128 * (int)n;
+#else
+  int sum = 0;
+  for (unsigned i = 0; i < n; i++) {
+    sum += w[i] * x[i];
+  }
+  return sum;
+#endif
+}
+
+// w[i] += x[i] if taken, w[i] -= x[i] otherwise, saturating at -127/127
+static inline void PerceptronTrain(int8_t *w, const int8_t *x, unsigned n, bool resolveDir) {
+#if defined(__AVX2__)
+  const __m256i t = _mm256_set1_epi8(resolveDir ? 1 : -1);
+  const __m256i lo = _mm256_set1_epi8(-127);
+  for (unsigned i = 0; i < n; i += 32) {
+    __m256i wv = _mm256_load_si256((const __m256i *)(w + i));
+    __m256i xv = _mm256_load_si256((const __m256i *)(x + i));
+    wv = _mm256_max_epi8(_mm256_adds_epi8(wv, _mm256_sign_epi8(xv, t)), lo);
+    _mm256_store_si256((__m256i *)(w + i), wv);
+  }
+#elif defined(__SSE2__)
+  const __m128i neg = resolveDir ? _mm_setzero_si128() : _mm_set1_epi8(-1);
+  const __m128i min = _mm_set1_epi8(-128);
+  for (unsigned i = 0; i < n; i += 16) {
+    __m128i wv = _mm_load_si128((const __m128i *)(w + i));
+    __m128i xv = _mm_load_si128((const __m128i *)(x + i));
+    __m128i delta = _mm_sub_epi8(_mm_xor_si128(xv, neg), neg);
+    wv = _mm_adds_epi8(wv, delta);
+    // -128 -> -127
+    wv = _mm_sub_epi8(wv, _mm_cmpeq_epi8(wv, min));
+    _mm_store_si128((__m128i *)(w + i), wv);
+  }
+#else
+  for (unsigned i = 0; i < n; i++) {
+    int v = w[i] + (resolveDir ? x[i] : -x[i]);
+    w[i] = v > 127 ? 127 : (v < -127 ? -127 : v);
+  }
+#endif
+}
+
+/////////////////////////////////////////////////////////////
+// perceptron
+/////////////////////////////////////////////////////////////
+/*
+Jimenez and Lin, "Dynamic branch prediction with perceptrons".
+2^LogRows weight vectors selected by PC, each with a bias weight and
+HistLen weights for the global history.
+Trains on a misprediction or when |y| <= theta = 1.93 * HistLen + 14.
+With delayed updates a branch keeps the inputs x it was predicted with.
+*/
+
+template <unsigned LogRows, unsigned HistLen>
+struct Perceptron {
+  static const UINT32 kRows = 1u << LogRows;
+  static const unsigned kRowLen = (HistLen + 1 + PERCEPTRON_VECTOR - 1) / PERCEPTRON_VECTOR * PERCEPTRON_VECTOR;
+  static const int kTheta = (int)(1.93 * HistLen + 14);
+  static const UINT64 kStorageBits = (UINT64)kRows * (HistLen + 1) * 8 + HistLen;
+
+  struct State {
+    alignas(PERCEPTRON_VECTOR) int8_t weights[kRows][kRowLen];
+    // x[0] is the bias input, x[1] the newest outcome
+    alignas(PERCEPTRON_VECTOR) int8_t x[kRowLen];
+
+    bool lookupValid;
+    UINT32 lookupPC;
+    int y;
+  };
+
+  static thread_local State tls;
+
+  static inline UINT32 Row(UINT32 PC) {
+    return (PC ^ (PC >> LogRows)) & (kRows - 1);
+  }
+
+  static void Init(State &s) {
+    memset(s.weights, 0, sizeof(s.weights));
+    memset(s.x, 0, sizeof(s.x));
+    s.x[0] = 1;
+    for (unsigned i = 1; i <= HistLen; i++) {
+      s.x[i] = -1; // assume history is not taken
+    }
+    s.lookupValid = false;
+  }
+
+  static bool Get(State &s, UINT32 PC) {
+    s.y = PerceptronDot(s.weights[Row(PC)], s.x, kRowLen);
+    s.lookupValid = true;
+    s.lookupPC = PC;
+    return s.y >= 0;
+  }
+
+  // shifts the outcome into the history inputs
+  static inline void ShiftHistory(int8_t *x, bool dir) {
+    memmove(x + 2, x + 1, HistLen - 1);
+    x[1] = dir ? 1 : -1;
+  }
+
+  static void Update(State &s, UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
+    if (!s.lookupValid || s.lookupPC != PC) {
+      Get(s, PC);
+    }
+
+    if ((s.y >= 0) != resolveDir || abs(s.y) <= kTheta) {
+      PerceptronTrain(s.weights[Row(PC)], s.x, kRowLen, resolveDir);
+    }
+
+    ShiftHistory(s.x, resolveDir);
+    s.lookupValid = false;
+  }
+
+  // the inputs and output of a predicted branch, kept in InFlightBranch::detail
+  // so it trains on the history it saw and a repair can restore it
+  struct InFlight {
+    alignas(PERCEPTRON_VECTOR) int8_t x[kRowLen];
+    int y;
+  };
+
+  static bool PipePredict(State &s, UINT32 PC, InFlightBranch *b, bool spec) {
+    InFlight f;
+    memcpy(f.x, s.x, sizeof(f.x));
+    f.y = PerceptronDot(s.weights[Row(PC)], s.x, kRowLen);
+    SaveState(&b->detail, f);
+    s.lookupValid = false;
+
+    if (spec) {
+      ShiftHistory(s.x, f.y >= 0);
+    }
+    return f.y >= 0;
+  }
+
+  static void PipeRepair(State &s, const InFlightBranch &b, bool resolveDir) {
+    InFlight f;
+    size_t pos = 0;
+    RestoreState(b.detail, &pos, &f);
+    memcpy(s.x, f.x, sizeof(s.x));
+    ShiftHistory(s.x, resolveDir);
+  }
+
+  static void PipeCommit(State &s, const InFlightBranch &b, bool resolveDir, bool spec) {
+    InFlight f;
+    size_t pos = 0;
+    RestoreState(b.detail, &pos, &f);
+    if ((f.y >= 0) != resolveDir || abs(f.y) <= kTheta) {
+      PerceptronTrain(s.weights[Row(b.PC)], f.x, kRowLen, resolveDir);
+    }
+
+    if (!spec) {
+      ShiftHistory(s.x, resolveDir);
+    }
+  }
+
+  // the registered functions, on the current thread's State
+  static void Init() { Init(tls); }
+  static bool Get(UINT32 PC) { return Get(tls, PC); }
+  static void Update(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
+    Update(tls, PC, resolveDir, predDir, branchTarget);
+  }
+  static bool PipePredict(UINT32 PC, InFlightBranch *b, bool spec) { return PipePredict(tls, PC, b, spec); }
+  static void PipeRepair(const InFlightBranch &b, bool resolveDir) { PipeRepair(tls, b, resolveDir); }
+  static void PipeCommit(const InFlightBranch &b, bool resolveDir, bool spec) { PipeCommit(tls, b, resolveDir, spec); }
+
+  static void Save(PredictorState *out) {
+    SaveState(out, tls);
+  }
+
+  static bool Restore(const PredictorState &in) {
+    size_t pos = 0;
+    return RestoreState(in, &pos, &tls) && pos == in.size();
+  }
+};
+
+template <unsigned LogRows, unsigned HistLen>
+thread_local typename Perceptron<LogRows, HistLen>::State Perceptron<LogRows, HistLen>::tls;
+
+/////////////////////////////////////////////////////////////
+// hashed perceptron
+/////////////////////////////////////////////////////////////
+/*
+Tarjan and Skadron, "Merging path and gshare indexing in perceptron
+branch prediction".
+NumTables tables of 2^LogRows int8 weights. Table 0 is indexed by PC
+alone, table i > 0 by PC xor the global history bits
+[start(i), start(i) + len(i)), with segments growing geometrically up
+to MaxHist bits. y is the sum of the NumTables selected weights.
+The sum is a handful of gathered bytes, so it stays scalar.
+With delayed updates a branch keeps the weights it read and its history.
+*/
+
+template <unsigned NumTables, unsigned LogRows, unsigned MaxHist>
+struct HashedPerceptron {
+  static_assert(MaxHist <= 64, "history is kept in 64 bits");
+
+  static const UINT32 kRows = 1u << LogRows;
+  static const int kTheta = (int)(2.14 * NumTables + 20.58);
+  static const UINT64 kStorageBits = (UINT64)NumTables * kRows * 8 + MaxHist;
+
+  struct State {
+    int8_t weights[NumTables][kRows];
+    uint64_t history;
+    unsigned segStart[NumTables];
+    unsigned segLen[NumTables];
+
+    bool lookupValid;
+    UINT32 lookupPC;
+    UINT32 index[NumTables];
+    int y;
+  };
+
+  static thread_local State tls;
+
+  static inline UINT32 Fold(uint64_t h, unsigned len) {
+    UINT32 folded = 0;
+    for (unsigned k = 0; k < len; k += LogRows) {
+      folded ^= (UINT32)(h >> k);
+    }
+    return folded;
+  }
+
+  static void Init(State &s) {
+    memset(s.weights, 0, sizeof(s.weights));
+    s.history = 0;
+
+    // geometric segment ends 0, ..., MaxHist
+    unsigned prevEnd = 0;
+    for (unsigned i = 0; i < NumTables; i++) {
+      unsigned end = i == 0 ? 0 : (unsigned)(MaxHist * (double)(1u << i) / (1u << (NumTables - 1)) + 0.5);
+      if (end <= prevEnd && i > 0) {
+        end = prevEnd + 1;
+      }
+      s.segStart[i] = i <= 1 ? 0 : prevEnd;
+      s.segLen[i] = end - s.segStart[i];
+      prevEnd = end;
+    }
+    s.lookupValid = false;
+  }
+
+  static bool Get(State &s, UINT32 PC) {
+    int y = 0;
+    for (unsigned i = 0; i < NumTables; i++) {
+      uint64_t seg = s.history >> s.segStart[i];
+      if (s.segLen[i] < 64) {
+        seg &= (1ull << s.segLen[i]) - 1;
+      }
+      s.index[i] = (PC ^ (PC >> LogRows) ^ Fold(seg, s.segLen[i]) ^ (i << (LogRows - 3))) & (kRows - 1);
+      y += s.weights[i][s.index[i]];
+    }
+    s.y = y;
+    s.lookupValid = true;
+    s.lookupPC = PC;
+    return y >= 0;
+  }
+
+  // trains the weights at index on a misprediction or a weak output y
+  static void Train(State &s, const UINT32 *index, int y, bool resolveDir) {
+    if ((y >= 0) != resolveDir || abs(y) <= kTheta) {
+      for (unsigned i = 0; i < NumTables; i++) {
+        int8_t &w = s.weights[i][index[i]];
+        if (resolveDir == TAKEN) {
+          if (w < 127) {
+            w++;
+          }
+        }
+        else {
+          if (w > -127) {
+            w--;
+          }
+        }
+      }
+    }
+  }
+
+  static void Update(State &s, UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
+    if (!s.lookupValid || s.lookupPC != PC) {
+      Get(s, PC);
+    }
+
+    Train(s, s.index, s.y, resolveDir);
+    s.history = (s.history << 1) | (resolveDir ? 1 : 0);
+    s.lookupValid = false;
+  }
+
+  // the weights read and the output of a predicted branch, plus the history
+  // it saw, kept in InFlightBranch::detail
+  struct InFlight {
+    UINT32 index[NumTables];
+    int y;
+    uint64_t history;
+  };
+
+  static bool PipePredict(State &s, UINT32 PC, InFlightBranch *b, bool spec) {
+    InFlight f;
+    f.history = s.history;
+    bool predDir = Get(s, PC);
+    memcpy(f.index, s.index, sizeof(f.index));
+    f.y = s.y;
+    SaveState(&b->detail, f);
+    s.lookupValid = false;
+
+    if (spec) {
+      s.history = (s.history << 1) | (predDir ? 1 : 0);
+    }
+    return predDir;
+  }
+
+  static void PipeRepair(State &s, const InFlightBranch &b, bool resolveDir) {
+    InFlight f;
+    size_t pos = 0;
+    RestoreState(b.detail, &pos, &f);
+    s.history = (f.history << 1) | (resolveDir ? 1 : 0);
+  }
+
+  static void PipeCommit(State &s, const InFlightBranch &b, bool resolveDir, bool spec) {
+    InFlight f;
+    size_t pos = 0;
+    RestoreState(b.detail, &pos, &f);
+    Train(s, f.index, f.y, resolveDir);
+
+    if (!spec) {
+      s.history = (s.history << 1) | (resolveDir ? 1 : 0);
+    }
+  }
+
+  // the registered functions, on the current thread's State
+  static void Init() { Init(tls); }
+  static bool Get(UINT32 PC) { return Get(tls, PC); }
+  static void Update(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
+    Update(tls, PC, resolveDir, predDir, branchTarget);
+  }
+  static bool PipePredict(UINT32 PC, InFlightBranch *b, bool spec) { return PipePredict(tls, PC, b, spec); }
+  static void PipeRepair(const InFlightBranch &b, bool resolveDir) { PipeRepair(tls, b, resolveDir); }
+  static void PipeCommit(const InFlightBranch &b, bool resolveDir, bool spec) { PipeCommit(tls, b, resolveDir, spec); }
+
+  static void Save(PredictorState *out) {
+    SaveState(out, tls);
+  }
+
+  static bool Restore(const PredictorState &in) {
+    size_t pos = 0;
+    return RestoreState(in, &pos, &tls) && pos == in.size();
+  }
+};
+
+template <unsigned NumTables, unsigned LogRows, unsigned MaxHist>
+thread_local typename HashedPerceptron<NumTables, LogRows, MaxHist>::State
+    HashedPerceptron<NumTables, LogRows, MaxHist>::tls;
+
+#endif
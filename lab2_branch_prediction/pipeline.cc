@@ -0,0 +1,18 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipeline.h"
+
+bool ParsePipelineConfig(const char *spec, PipelineConfig *cfg) {
+  char *end;
+  cfg->depth = strtoul(spec, &end, 10);
+  cfg->spec = true;
+  if (end == spec) {
+    return false;
+  }
+  if (strcmp(end, ",nonspec") == 0) {
+    cfg->spec = false;
+    return true;
+  }
+  return *end == '\0';
+}
@@ -0,0 +1,79 @@
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+#include <deque>
+
+#include "bpsim.h"
+
+/////////////////////////////////////////////////////////////
+// delayed update
+/////////////////////////////////////////////////////////////
+/*
+Models a front end that trains its tables at commit, depth branches
+after the prediction, while misprediction recovery happens at resolve.
+A predicted branch waits in an in-order queue and trains the counters
+it read (PipeCommit) once depth younger branches have been predicted.
+
+  spec     histories take the predicted direction at predict time; a
+           mispredicted branch repairs them (PipeRepair) from its copy
+           of the history plus the real outcome
+  nonspec  histories only take outcomes at commit, so a prediction
+           does not see the last depth outcomes
+
+The traces hold the correct path only and fetch restarts after the
+redirect, so a misprediction is repaired before the next branch is
+predicted, but its counter is still trained at commit.
+Depth 0 with spec is the same as Get/Update.
+*/
+
+struct PipelineConfig {
+  unsigned depth;
+  bool spec;
+};
+
+// parses <depth>[,nonspec], false on a syntax error
+bool ParsePipelineConfig(const char *spec, PipelineConfig *cfg);
+
+class PredictorPipeline {
+ public:
+  PredictorPipeline(const PredictorDesc &pred, const PipelineConfig &cfg) : pred(pred), cfg(cfg) {}
+
+  // predicts rec, commits what leaves the queue, returns true on a misprediction
+  inline bool Process(const BranchRecord &rec) {
+    inFlight.push_back(InFlightBranch());
+    InFlightBranch &b = inFlight.back();
+    b.PC = rec.PC;
+    b.branchTarget = rec.branchTarget;
+    b.taken = rec.taken;
+    b.predDir = pred.PipePredict(rec.PC, &b, cfg.spec);
+
+    bool mispred = b.predDir != b.taken;
+    if (mispred && cfg.spec) {
+      pred.PipeRepair(b, b.taken);
+    }
+    while (inFlight.size() > cfg.depth) {
+      Commit();
+    }
+    return mispred;
+  }
+
+  // commits everything still in flight (end of trace)
+  void Drain() {
+    while (!inFlight.empty()) {
+      Commit();
+    }
+  }
+
+ private:
+  inline void Commit() {
+    const InFlightBranch &b = inFlight.front();
+    pred.PipeCommit(b, b.taken, cfg.spec);
+    inFlight.pop_front();
+  }
+
+  const PredictorDesc &pred;
+  PipelineConfig cfg;
+  std::deque<InFlightBranch> inFlight;
+};
+
+#endif
@@ -3,26 +3,67 @@
 
 #include "utils.h"
 #include "tracer.h"
+#include "predictor_templates.h"
+#include "tage.h"
+#include "perceptron.h"
 
 /////////////////////////////////////////////////////////////
 
+typedef Bimodal<12, 2, PcIndex<2> > Predictor_2bitsat;
+
 void InitPredictor_2bitsat();
 bool GetPrediction_2bitsat(UINT32 PC);  
 void UpdatePredictor_2bitsat(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget);
 
 /////////////////////////////////////////////////////////////
 
+typedef TwoLevelLocal<9, 3, 6, 3, 2> Predictor_2level;
+
 void InitPredictor_2level();
 bool GetPrediction_2level(UINT32 PC);  
 void UpdatePredictor_2level(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget);
 
 /////////////////////////////////////////////////////////////
 
+typedef Gshare<15, 15, 3, PcXorHistory<0> > Predictor_openend;
+
 void InitPredictor_openend();
 bool GetPrediction_openend(UINT32 PC);  
 void UpdatePredictor_openend(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget);
 
 /////////////////////////////////////////////////////////////
 
+typedef PShare<8, 8, 8, 8, 3> Predictor_pshare;
+
+void InitPredictor_pshare();
+bool GetPrediction_pshare(UINT32 PC);
+void UpdatePredictor_pshare(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget);
+
+/////////////////////////////////////////////////////////////
+
+typedef Tage<13, 10, 8, 5, 300, 11> Predictor_tage;
+
+void InitPredictor_tage();
+bool GetPrediction_tage(UINT32 PC);
+void UpdatePredictor_tage(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget);
+
+/////////////////////////////////////////////////////////////
+
+typedef Perceptron<9, 63> Predictor_perceptron;
+
+void InitPredictor_perceptron();
+bool GetPrediction_perceptron(UINT32 PC);
+void UpdatePredictor_perceptron(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget);
+
+/////////////////////////////////////////////////////////////
+
+typedef HashedPerceptron<16, 10, 64> Predictor_hperceptron;
+
+void InitPredictor_hperceptron();
+bool GetPrediction_hperceptron(UINT32 PC);
+void UpdatePredictor_hperceptron(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget);
+
+/////////////////////////////////////////////////////////////
+
 #endif
 
@@ -0,0 +1,155 @@
+#include <stdarg.h>
+#include <string.h>
+
+#include "alias.h"
+#include "bpsim.h"
+#include "predictor_templates.h"
+#include "tage.h"
+#include "perceptron.h"
+
+/////////////////////////////////////////////////////////////
+// predictor grid
+/////////////////////////////////////////////////////////////
+/*
+Instantiates a sweep of the predictor templates for budget/accuracy
+experiments. Each point is its own template instance, so the masks and
+shifts of every point stay compile time constants.
+
+bimodal-<entries>-c<ctr bits>                   PC[..:2] indexed counters
+gshare-<entries>-h<hist bits>-c<ctr bits>       PC xor global history
+2level-<bht entries>-h<hist bits>-c<ctr bits>   8 PHTs selected by PC[2:0]
+pshare-<bht entries>-h<hist bits>-c<ctr bits>   PC xor local history
+<XAy>-b<regs>-h<hist bits>-p<phts>-c<ctr bits>  Yeh-Patt schemes GAg ... SAs
+                                                at 1 to 4 KB
+tage-<tables>x<entries>-h<max hist>             TAGE storage budgets
+perceptron-<rows>-h<hist bits>                  global history perceptron
+hperceptron-<tables>x<entries>-h<hist bits>     hashed perceptron
+
+The counter table points are also registered as alias-<name> (alias.h).
+*/
+
+static const char *GridName(const char *fmt, ...) {
+  char name[64];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(name, sizeof(name), fmt, args);
+  va_end(args);
+  return strdup(name);
+}
+
+// bimodal, table size 2^LogSize for LogSize in [LogSize, MaxLog]
+template <unsigned LogSize, unsigned MaxLog, unsigned CtrBits, bool Done = (LogSize > MaxLog)>
+struct BimodalSweep {
+  static void Register() {
+    typedef Bimodal<LogSize, CtrBits, PcIndex<2> > P;
+    const char *name = GridName("bimodal-%u-c%u", P::kSize, CtrBits);
+    RegisterTemplate<P>(name);
+    RegisterAliasShadow<P>(name);
+    BimodalSweep<LogSize + 1, MaxLog, CtrBits>::Register();
+  }
+};
+
+template <unsigned LogSize, unsigned MaxLog, unsigned CtrBits>
+struct BimodalSweep<LogSize, MaxLog, CtrBits, true> {
+  static void Register() {}
+};
+
+// gshare, table size 2^LogSize with as many history bits as index bits
+template <unsigned LogSize, unsigned MaxLog, unsigned CtrBits, bool Done = (LogSize > MaxLog)>
+struct GshareSizeSweep {
+  static void Register() {
+    typedef Gshare<LogSize, LogSize, CtrBits, PcXorHistory<0> > P;
+    const char *name = GridName("gshare-%u-h%u-c%u", P::kSize, LogSize, CtrBits);
+    RegisterTemplate<P>(name);
+    RegisterAliasShadow<P>(name);
+    GshareSizeSweep<LogSize + 1, MaxLog, CtrBits>::Register();
+  }
+};
+
+template <unsigned LogSize, unsigned MaxLog, unsigned CtrBits>
+struct GshareSizeSweep<LogSize, MaxLog, CtrBits, true> {
+  static void Register() {}
+};
+
+// gshare, fixed table size, history length in [HistBits, MaxHist] by Step
+template <unsigned LogSize, unsigned HistBits, unsigned MaxHist, unsigned Step, unsigned CtrBits,
+          bool Done = (HistBits > MaxHist)>
+struct GshareHistSweep {
+  static void Register() {
+    typedef Gshare<LogSize, HistBits, CtrBits, PcXorHistory<0> > P;
+    const char *name = GridName("gshare-%u-h%u-c%u", P::kSize, HistBits, CtrBits);
+    RegisterTemplate<P>(name);
+    RegisterAliasShadow<P>(name);
+    GshareHistSweep<LogSize, HistBits + Step, MaxHist, Step, CtrBits>::Register();
+  }
+};
+
+template <unsigned LogSize, unsigned HistBits, unsigned MaxHist, unsigned Step, unsigned CtrBits>
+struct GshareHistSweep<LogSize, HistBits, MaxHist, Step, CtrBits, true> {
+  static void Register() {}
+};
+
+// two level local, 8 PHTs, local history length in [HistBits, MaxHist]
+template <unsigned LogBht, unsigned HistBits, unsigned MaxHist, unsigned CtrBits,
+          bool Done = (HistBits > MaxHist)>
+struct TwoLevelSweep {
+  static void Register() {
+    typedef TwoLevelLocal<LogBht, 3, HistBits, 3, CtrBits> P;
+    const char *name = GridName("2level-%u-h%u-c%u", P::kBhtSize, HistBits, CtrBits);
+    RegisterTemplate<P>(name);
+    RegisterAliasShadow<P>(name);
+    TwoLevelSweep<LogBht, HistBits + 1, MaxHist, CtrBits>::Register();
+  }
+};
+
+template <unsigned LogBht, unsigned HistBits, unsigned MaxHist, unsigned CtrBits>
+struct TwoLevelSweep<LogBht, HistBits, MaxHist, CtrBits, true> {
+  static void Register() {}
+};
+
+// one Yeh-Patt scheme, registered as <scheme>-b<regs>-h<hist bits>-p<phts>-c<ctr bits>
+template <unsigned LogHist, class HistSet, unsigned HistBits, unsigned LogPhts, class PhtSet, unsigned CtrBits>
+static void RegisterTwoLevel(const char *scheme) {
+  typedef TwoLevel<LogHist, HistSet, HistBits, LogPhts, PhtSet, CtrBits> P;
+  const char *name = GridName("%s-b%u-h%u-p%u-c%u", scheme, P::kBhtSize, HistBits, 1u << LogPhts, CtrBits);
+  RegisterTemplate<P>(name);
+  RegisterAliasShadow<P>(name);
+}
+
+void RegisterPredictorGrid() {
+  BimodalSweep<10, 16, 2>::Register();
+  BimodalSweep<10, 16, 3>::Register();
+
+  GshareSizeSweep<10, 18, 2>::Register();
+  GshareSizeSweep<8, 18, 3>::Register();
+  GshareHistSweep<15, 0, 12, 2, 3>::Register();
+
+  TwoLevelSweep<9, 4, 12, 2>::Register();
+  TwoLevelSweep<12, 4, 12, 2>::Register();
+
+  RegisterTwoLevel<0, SetPc<0>, 14, 0, SetPc<0>, 2>("GAg");
+  RegisterTwoLevel<0, SetPc<0>, 10, 4, SetHash<0>, 2>("GAs");
+  RegisterTwoLevel<0, SetPc<0>, 8, 6, SetPc<0>, 2>("GAp");
+  RegisterTwoLevel<10, SetPc<0>, 12, 0, SetPc<0>, 2>("PAg");
+  RegisterTwoLevel<10, SetPc<0>, 8, 4, SetHash<0>, 2>("PAs");
+  RegisterTwoLevel<10, SetPc<0>, 6, 6, SetPc<0>, 2>("PAp");
+  RegisterTwoLevel<6, SetHash<0>, 12, 0, SetPc<0>, 2>("SAg");
+  RegisterTwoLevel<6, SetHash<0>, 10, 4, SetHash<0>, 2>("SAs");
+
+  RegisterTemplate<PShare<12, 12, 12, 12, 2> >("pshare-4096-h12-c2");
+  RegisterAliasShadow<PShare<12, 12, 12, 12, 2> >("pshare-4096-h12-c2");
+
+  RegisterTemplate<Tage<12, 9, 5, 5, 80, 9> >("tage-5x512-h80");
+  RegisterTemplate<Tage<13, 10, 8, 5, 300, 11> >("tage-8x1024-h300");
+  RegisterTemplate<Tage<14, 11, 12, 4, 640, 12> >("tage-12x2048-h640");
+
+  RegisterTemplate<Perceptron<8, 31> >("perceptron-256-h31");
+  RegisterTemplate<Perceptron<9, 31> >("perceptron-512-h31");
+  RegisterTemplate<Perceptron<8, 63> >("perceptron-256-h63");
+  RegisterTemplate<Perceptron<10, 63> >("perceptron-1024-h63");
+  RegisterTemplate<Perceptron<8, 127> >("perceptron-256-h127");
+  RegisterTemplate<Perceptron<9, 127> >("perceptron-512-h127");
+
+  RegisterTemplate<HashedPerceptron<8, 10, 32> >("hperceptron-8x1024-h32");
+  RegisterTemplate<HashedPerceptron<16, 11, 64> >("hperceptron-16x2048-h64");
+}
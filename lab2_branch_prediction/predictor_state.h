@@ -0,0 +1,63 @@
+#ifndef _PREDICTOR_STATE_H_
+#define _PREDICTOR_STATE_H_
+
+#include <string.h>
+
+#include <string>
+
+#include "utils.h"
+
+/////////////////////////////////////////////////////////////
+// predictor checkpoints
+/////////////////////////////////////////////////////////////
+/*
+A checkpoint is the raw bytes of every table and history of a
+predictor, appended in a fixed order by its Save and read back in the
+same order by Restore. The tables are plain arrays without pointers,
+so a byte copy is a complete copy, but a checkpoint is only valid for
+the same template instance on the same host.
+*/
+
+typedef std::string PredictorState;
+
+template <class T>
+inline void SaveState(PredictorState *out, const T &obj) {
+  out->append((const char *)&obj, sizeof(T));
+}
+
+// false if in is too short
+template <class T>
+inline bool RestoreState(const PredictorState &in, size_t *pos, T *obj) {
+  if (*pos + sizeof(T) > in.size()) {
+    return false;
+  }
+  memcpy((void *)obj, in.data() + *pos, sizeof(T));
+  *pos += sizeof(T);
+  return true;
+}
+
+/////////////////////////////////////////////////////////////
+// in-flight branches
+/////////////////////////////////////////////////////////////
+/*
+What a predictor remembers about a branch between predicting it and
+training on its outcome when updates are delayed (pipeline.h): the
+counter it read and the history it saw, so the history can be repaired
+and the counter trained later.
+Predictors whose lookup or history does not fit the fixed fields
+(TAGE, the perceptrons) append a copy of them to detail with
+SaveState.
+*/
+
+struct InFlightBranch {
+  UINT32 PC;
+  UINT32 branchTarget;
+  UINT32 index;          // counter read at predict time
+  UINT32 historyIndex;   // history register (local predictors)
+  UINT32 history;        // history before the speculative update
+  PredictorState detail; // anything else the predictor saw at predict time
+  bool predDir;
+  bool taken;
+};
+
+#endif
@@ -0,0 +1,489 @@
+#ifndef _PREDICTOR_TEMPLATES_H_
+#define _PREDICTOR_TEMPLATES_H_
+
+#include "utils.h"
+#include "packed_counters.h"
+#include "predictor_state.h"
+
+/////////////////////////////////////////////////////////////
+// parameterized predictors
+/////////////////////////////////////////////////////////////
+/*
+Table sizes, history lengths, counter widths and index functions are
+template parameters, so every mask and shift is a compile time
+constant in Get/Update.
+Counter tables are PackedCounters, so a table takes entries * CtrBits
+bits of host memory (rounded to whole 64-bit words).
+The tables and histories of a template are its State, and every
+function has an overload taking the State it works on. The overloads
+without one run on the current thread's copy (tls), which lets
+&P::Init, &P::Get and &P::Update be registered like the hand written
+predictors in predictor.cc (see RegisterTemplate in bpsim.h), while a
+hybrid runs the same code on a State of its own (StateHooks in
+bpsim.h).
+
+Every template also exposes the counter it would use for PC
+(CounterIndex), the branch and history that select it (PatternKey)
+and, for local predictors, the history register of PC (HistoryIndex),
+so alias.h can shadow the tables without touching Get/Update.
+Save/Restore copy the tables and histories (predictor_state.h).
+PipePredict/PipeRepair/PipeCommit split Get/Update for delayed updates
+(pipeline.h): with spec the histories take the predicted direction at
+predict time and PipeRepair fixes them after a misprediction,
+otherwise they only take the outcome in PipeCommit, which also trains
+the counters.
+*/
+
+/////////////////////////////////////////////////////////////
+// index functions
+/////////////////////////////////////////////////////////////
+
+// PC[31:Shift]
+template <unsigned Shift>
+struct PcIndex {
+  static inline UINT32 Index(UINT32 PC, UINT32 history) { return PC >> Shift; }
+};
+
+// PC[31:Shift] xor history (gshare)
+template <unsigned Shift>
+struct PcXorHistory {
+  static inline UINT32 Index(UINT32 PC, UINT32 history) { return (PC >> Shift) ^ history; }
+};
+
+// PC[31:Shift] concatenated with a HistBits wide history (gselect)
+template <unsigned Shift, unsigned HistBits>
+struct PcConcatHistory {
+  static inline UINT32 Index(UINT32 PC, UINT32 history) { return ((PC >> Shift) << HistBits) | history; }
+};
+
+/////////////////////////////////////////////////////////////
+// bimodal
+/////////////////////////////////////////////////////////////
+/*
+2^LogSize counters of CtrBits bits indexed by IndexFn(PC)
+*/
+
+template <unsigned LogSize, unsigned CtrBits, class IndexFn>
+struct Bimodal {
+  static const UINT32 kSize = 1u << LogSize;
+  static const UINT32 kMask = kSize - 1;
+  static const UINT64 kStorageBits = (UINT64)kSize * CtrBits;
+  static const UINT32 kCounters = kSize;
+  static const UINT32 kHistoryEntries = 0;
+
+  typedef PackedCounters<CtrBits, kSize> Table;
+
+  struct State {
+    Table table;
+  };
+
+  static thread_local State tls;
+
+  static inline UINT32 CounterIndex(const State &s, UINT32 PC) { return IndexFn::Index(PC, 0) & kMask; }
+  static inline uint64_t PatternKey(const State &s, UINT32 PC) { return PC; }
+  static inline UINT32 HistoryIndex(UINT32 PC) { return 0; }
+
+  static void Init(State &s) {
+    s.table.Fill(WEAK_NOT_TAKEN(CtrBits));
+  }
+
+  static bool Get(State &s, UINT32 PC) {
+    return s.table.Taken(CounterIndex(s, PC));
+  }
+
+  static void Update(State &s, UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
+    s.table.Update(CounterIndex(s, PC), resolveDir);
+  }
+
+  static bool PipePredict(State &s, UINT32 PC, InFlightBranch *b, bool spec) {
+    b->index = CounterIndex(s, PC);
+    return s.table.Taken(b->index);
+  }
+
+  static void PipeRepair(State &s, const InFlightBranch &b, bool resolveDir) {}
+
+  static void PipeCommit(State &s, const InFlightBranch &b, bool resolveDir, bool spec) {
+    s.table.Update(b.index, resolveDir);
+  }
+
+  // the registered functions, on the current thread's State
+  static inline UINT32 CounterIndex(UINT32 PC) { return CounterIndex(tls, PC); }
+  static inline uint64_t PatternKey(UINT32 PC) { return PatternKey(tls, PC); }
+  static void Init() { Init(tls); }
+  static bool Get(UINT32 PC) { return Get(tls, PC); }
+  static void Update(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
+    Update(tls, PC, resolveDir, predDir, branchTarget);
+  }
+  static bool PipePredict(UINT32 PC, InFlightBranch *b, bool spec) { return PipePredict(tls, PC, b, spec); }
+  static void PipeRepair(const InFlightBranch &b, bool resolveDir) { PipeRepair(tls, b, resolveDir); }
+  static void PipeCommit(const InFlightBranch &b, bool resolveDir, bool spec) { PipeCommit(tls, b, resolveDir, spec); }
+
+  static void Save(PredictorState *out) {
+    SaveState(out, tls.table);
+  }
+
+  static bool Restore(const PredictorState &in) {
+    size_t pos = 0;
+    return RestoreState(in, &pos, &tls.table) && pos == in.size();
+  }
+};
+
+template <unsigned LogSize, unsigned CtrBits, class IndexFn>
+thread_local typename Bimodal<LogSize, CtrBits, IndexFn>::State Bimodal<LogSize, CtrBits, IndexFn>::tls;
+
+/////////////////////////////////////////////////////////////
+// global history
+/////////////////////////////////////////////////////////////
+/*
+2^LogSize counters indexed by IndexFn(PC, HistBits of global history)
+*/
+
+template <unsigned LogSize, unsigned HistBits, unsigned CtrBits, class IndexFn>
+struct Gshare {
+  static const UINT32 kSize = 1u << LogSize;
+  static const UINT32 kMask = kSize - 1;
+  static const UINT32 kHistMask = (1u << HistBits) - 1;
+  static const UINT64 kStorageBits = (UINT64)kSize * CtrBits + HistBits;
+  static const UINT32 kCounters = kSize;
+  static const UINT32 kHistoryEntries = 0;
+
+  typedef PackedCounters<CtrBits, kSize> Table;
+
+  struct State {
+    UINT32 history;
+    Table table;
+  };
+
+  static thread_local State tls;
+
+  static inline UINT32 CounterIndex(const State &s, UINT32 PC) { return IndexFn::Index(PC, s.history) & kMask; }
+  static inline uint64_t PatternKey(const State &s, UINT32 PC) { return ((uint64_t)s.history << 32) | PC; }
+  static inline UINT32 HistoryIndex(UINT32 PC) { return 0; }
+
+  static void Init(State &s) {
+    s.history = 0;
+    s.table.Fill(WEAK_NOT_TAKEN(CtrBits));
+  }
+
+  static bool Get(State &s, UINT32 PC) {
+    return s.table.Taken(CounterIndex(s, PC));
+  }
+
+  static void Update(State &s, UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
+    s.table.Update(CounterIndex(s, PC), resolveDir);
+    s.history = ((s.history << 1) | (resolveDir ? 1 : 0)) & kHistMask;
+  }
+
+  static bool PipePredict(State &s, UINT32 PC, InFlightBranch *b, bool spec) {
+    b->index = CounterIndex(s, PC);
+    b->history = s.history;
+    bool predDir = s.table.Taken(b->index);
+    if (spec) {
+      s.history = ((s.history << 1) | (predDir ? 1 : 0)) & kHistMask;
+    }
+    return predDir;
+  }
+
+  // only called for the youngest branch, the ones after it were not fetched yet
+  static void PipeRepair(State &s, const InFlightBranch &b, bool resolveDir) {
+    s.history = ((b.history << 1) | (resolveDir ? 1 : 0)) & kHistMask;
+  }
+
+  static void PipeCommit(State &s, const InFlightBranch &b, bool resolveDir, bool spec) {
+    s.table.Update(b.index, resolveDir);
+    if (!spec) {
+      s.history = ((s.history << 1) | (resolveDir ? 1 : 0)) & kHistMask;
+    }
+  }
+
+  // the registered functions, on the current thread's State
+  static inline UINT32 CounterIndex(UINT32 PC) { return CounterIndex(tls, PC); }
+  static inline uint64_t PatternKey(UINT32 PC) { return PatternKey(tls, PC); }
+  static void Init() { Init(tls); }
+  static bool Get(UINT32 PC) { return Get(tls, PC); }
+  static void Update(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
+    Update(tls, PC, resolveDir, predDir, branchTarget);
+  }
+  static bool PipePredict(UINT32 PC, InFlightBranch *b, bool spec) { return PipePredict(tls, PC, b, spec); }
+  static void PipeRepair(const InFlightBranch &b, bool resolveDir) { PipeRepair(tls, b, resolveDir); }
+  static void PipeCommit(const InFlightBranch &b, bool resolveDir, bool spec) { PipeCommit(tls, b, resolveDir, spec); }
+
+  static void Save(PredictorState *out) {
+    SaveState(out, tls.history);
+    SaveState(out, tls.table);
+  }
+
+  static bool Restore(const PredictorState &in) {
+    size_t pos = 0;
+    return RestoreState(in, &pos, &tls.history) && RestoreState(in, &pos, &tls.table) && pos == in.size();
+  }
+};
+
+template <unsigned LogSize, unsigned HistBits, unsigned CtrBits, class IndexFn>
+thread_local typename Gshare<LogSize, HistBits, CtrBits, IndexFn>::State Gshare<LogSize, HistBits, CtrBits, IndexFn>::tls;
+
+/////////////////////////////////////////////////////////////
+// two level (Yeh and Patt)
+/////////////////////////////////////////////////////////////
+/*
+Yeh and Patt, "Alternative implementations of two-level adaptive
+branch prediction": a first level of branch history registers and a
+second level of pattern history tables.
+
+  2^LogHist history registers of HistBits bits, selected by
+            HistSet::Index(PC, LogHist)
+  2^LogPhts PHTs of 2^HistBits counters, selected by
+            PhtSet::Index(PC, LogPhts) and indexed by the history
+
+LogHist = 0 is one global register (G), LogPhts = 0 one global PHT
+(g). Otherwise the set functions below pick per-address (P/p, SetPc:
+consecutive branches get their own entry until the table wraps) or
+per-set (S/s, SetHash: a hash of the PC spreads branches over sets):
+
+  GAg  TwoLevel<0, SetPc<0>,  h, 0, SetPc<0>,   c>
+  GAs  TwoLevel<0, SetPc<0>,  h, p, SetHash<0>, c>
+  GAp  TwoLevel<0, SetPc<0>,  h, p, SetPc<0>,   c>
+  PAg  TwoLevel<b, SetPc<0>,  h, 0, SetPc<0>,   c>
+  PAs  TwoLevel<b, SetPc<0>,  h, p, SetHash<0>, c>
+  PAp  TwoLevel<b, SetPc<0>,  h, p, SetPc<0>,   c>
+  SAg  TwoLevel<b, SetHash<0>, h, 0, SetPc<0>,  c>
+  SAs  TwoLevel<b, SetHash<0>, h, p, SetHash<0>, c>
+
+The PHTs are one packed table, PHT-major: the 2^HistBits counters a
+branch cycles through are contiguous (16 bytes for 6 bits of history
+and 2-bit counters), so a branch touches one or two cache lines of the
+PHT however many PHTs there are. Histories are uint16_t, one
+contiguous array.
+kStorageBits counts every history register and counter, so all eight
+schemes share one cost model.
+*/
+
+// PC[..:Shift], the low bits pick the set (per address)
+template <unsigned Shift>
+struct SetPc {
+  static inline UINT32 Index(UINT32 PC, unsigned logSets) { return PC >> Shift; }
+};
+
+// multiplicative hash of PC[..:Shift], the top bits pick the set (per set)
+template <unsigned Shift>
+struct SetHash {
+  static inline UINT32 Index(UINT32 PC, unsigned logSets) {
+    return logSets ? ((PC >> Shift) * 0x9E3779B1u) >> (32 - logSets) : 0;
+  }
+};
+
+template <unsigned LogHist, class HistSet, unsigned HistBits, unsigned LogPhts, class PhtSet, unsigned CtrBits>
+struct TwoLevel {
+  static_assert(HistBits <= 16, "histories are stored in 16 bits");
+
+  static const UINT32 kBhtSize = 1u << LogHist;
+  static const UINT32 kBhtMask = kBhtSize - 1;
+  static const UINT32 kHistMask = (1u << HistBits) - 1;
+  static const UINT32 kPhtMask = (1u << LogPhts) - 1;
+  static const UINT32 kPhtSize = 1u << (LogPhts + HistBits);
+  static const UINT64 kStorageBits = (UINT64)kBhtSize * HistBits + (UINT64)kPhtSize * CtrBits;
+  static const UINT32 kCounters = kPhtSize;
+  // a global history register is not a table alias.h can watch
+  static const UINT32 kHistoryEntries = LogHist ? kBhtSize : 0;
+
+  typedef PackedCounters<CtrBits, kPhtSize> Table;
+
+  struct State {
+    uint16_t bht[kBhtSize];
+    Table pht;
+  };
+
+  static thread_local State tls;
+
+  static inline UINT32 HistoryIndex(UINT32 PC) { return HistSet::Index(PC, LogHist) & kBhtMask; }
+
+  static inline UINT32 PhtIndex(const State &s, UINT32 PC) {
+    UINT32 history = s.bht[HistoryIndex(PC)];
+    return ((PhtSet::Index(PC, LogPhts) & kPhtMask) << HistBits) | history;
+  }
+
+  static inline UINT32 CounterIndex(const State &s, UINT32 PC) { return PhtIndex(s, PC); }
+  static inline uint64_t PatternKey(const State &s, UINT32 PC) { return ((uint64_t)s.bht[HistoryIndex(PC)] << 32) | PC; }
+
+  static void Init(State &s) {
+    for (UINT32 i = 0; i < kBhtSize; i++) {
+      s.bht[i] = 0; // assume history is not taken
+    }
+    s.pht.Fill(WEAK_NOT_TAKEN(CtrBits));
+  }
+
+  static bool Get(State &s, UINT32 PC) {
+    return s.pht.Taken(PhtIndex(s, PC));
+  }
+
+  static void Update(State &s, UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
+    s.pht.Update(PhtIndex(s, PC), resolveDir);
+
+    // update the history for the given branch
+    uint16_t &history = s.bht[HistoryIndex(PC)];
+    history = ((history << 1) | (resolveDir ? 1 : 0)) & kHistMask;
+  }
+
+  static bool PipePredict(State &s, UINT32 PC, InFlightBranch *b, bool spec) {
+    b->index = PhtIndex(s, PC);
+    b->historyIndex = HistoryIndex(PC);
+    b->history = s.bht[b->historyIndex];
+    bool predDir = s.pht.Taken(b->index);
+    if (spec) {
+      s.bht[b->historyIndex] = ((b->history << 1) | (predDir ? 1 : 0)) & kHistMask;
+    }
+    return predDir;
+  }
+
+  static void PipeRepair(State &s, const InFlightBranch &b, bool resolveDir) {
+    s.bht[b.historyIndex] = ((b.history << 1) | (resolveDir ? 1 : 0)) & kHistMask;
+  }
+
+  static void PipeCommit(State &s, const InFlightBranch &b, bool resolveDir, bool spec) {
+    s.pht.Update(b.index, resolveDir);
+    if (!spec) {
+      uint16_t &history = s.bht[b.historyIndex];
+      history = ((history << 1) | (resolveDir ? 1 : 0)) & kHistMask;
+    }
+  }
+
+  // the registered functions, on the current thread's State
+  static inline UINT32 CounterIndex(UINT32 PC) { return CounterIndex(tls, PC); }
+  static inline uint64_t PatternKey(UINT32 PC) { return PatternKey(tls, PC); }
+  static void Init() { Init(tls); }
+  static bool Get(UINT32 PC) { return Get(tls, PC); }
+  static void Update(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
+    Update(tls, PC, resolveDir, predDir, branchTarget);
+  }
+  static bool PipePredict(UINT32 PC, InFlightBranch *b, bool spec) { return PipePredict(tls, PC, b, spec); }
+  static void PipeRepair(const InFlightBranch &b, bool resolveDir) { PipeRepair(tls, b, resolveDir); }
+  static void PipeCommit(const InFlightBranch &b, bool resolveDir, bool spec) { PipeCommit(tls, b, resolveDir, spec); }
+
+  static void Save(PredictorState *out) {
+    SaveState(out, tls.bht);
+    SaveState(out, tls.pht);
+  }
+
+  static bool Restore(const PredictorState &in) {
+    size_t pos = 0;
+    return RestoreState(in, &pos, &tls.bht) && RestoreState(in, &pos, &tls.pht) && pos == in.size();
+  }
+};
+
+template <unsigned LogHist, class HistSet, unsigned HistBits, unsigned LogPhts, class PhtSet, unsigned CtrBits>
+thread_local typename TwoLevel<LogHist, HistSet, HistBits, LogPhts, PhtSet, CtrBits>::State TwoLevel<LogHist, HistSet, HistBits, LogPhts, PhtSet, CtrBits>::tls;
+
+/*
+The local predictor of predictor.h (PAp): 2^LogBht local histories
+indexed by PC[LogBht+BhtShift-1:BhtShift], 2^LogPhts PHTs selected by
+the low PC bits
+*/
+template <unsigned LogBht, unsigned BhtShift, unsigned HistBits, unsigned LogPhts, unsigned CtrBits>
+using TwoLevelLocal = TwoLevel<LogBht, SetPc<BhtShift>, HistBits, LogPhts, SetPc<0>, CtrBits>;
+
+/////////////////////////////////////////////////////////////
+// pshare
+/////////////////////////////////////////////////////////////
+/*
+2^LogBht private histories of HistBits bits indexed by PC[..:BhtShift]
+2^LogPht counters indexed by PC xor the private history
+*/
+
+template <unsigned LogBht, unsigned BhtShift, unsigned HistBits, unsigned LogPht, unsigned CtrBits>
+struct PShare {
+  static const UINT32 kBhtSize = 1u << LogBht;
+  static const UINT32 kBhtMask = kBhtSize - 1;
+  static const UINT32 kHistMask = (1u << HistBits) - 1;
+  static const UINT32 kPhtSize = 1u << LogPht;
+  static const UINT32 kPhtMask = kPhtSize - 1;
+  static const UINT64 kStorageBits = (UINT64)kBhtSize * HistBits + (UINT64)kPhtSize * CtrBits;
+  static const UINT32 kCounters = kPhtSize;
+  static const UINT32 kHistoryEntries = kBhtSize;
+
+  typedef PackedCounters<CtrBits, kPhtSize> Table;
+
+  struct State {
+    uint16_t bht[kBhtSize];
+    Table pht;
+  };
+
+  static thread_local State tls;
+
+  static inline UINT32 HistoryIndex(UINT32 PC) { return (PC >> BhtShift) & kBhtMask; }
+
+  static inline UINT32 PhtIndex(const State &s, UINT32 PC) {
+    return (PC ^ s.bht[HistoryIndex(PC)]) & kPhtMask;
+  }
+
+  static inline UINT32 CounterIndex(const State &s, UINT32 PC) { return PhtIndex(s, PC); }
+  static inline uint64_t PatternKey(const State &s, UINT32 PC) { return ((uint64_t)s.bht[HistoryIndex(PC)] << 32) | PC; }
+
+  static void Init(State &s) {
+    for (UINT32 i = 0; i < kBhtSize; i++) {
+      s.bht[i] = 0; // assume history is not taken
+    }
+    s.pht.Fill(WEAK_NOT_TAKEN(CtrBits));
+  }
+
+  static bool Get(State &s, UINT32 PC) {
+    return s.pht.Taken(PhtIndex(s, PC));
+  }
+
+  static void Update(State &s, UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
+    s.pht.Update(PhtIndex(s, PC), resolveDir);
+
+    // update the history for the given branch
+    uint16_t &history = s.bht[HistoryIndex(PC)];
+    history = ((history << 1) | (resolveDir ? 1 : 0)) & kHistMask;
+  }
+
+  static bool PipePredict(State &s, UINT32 PC, InFlightBranch *b, bool spec) {
+    b->index = PhtIndex(s, PC);
+    b->historyIndex = HistoryIndex(PC);
+    b->history = s.bht[b->historyIndex];
+    bool predDir = s.pht.Taken(b->index);
+    if (spec) {
+      s.bht[b->historyIndex] = ((b->history << 1) | (predDir ? 1 : 0)) & kHistMask;
+    }
+    return predDir;
+  }
+
+  static void PipeRepair(State &s, const InFlightBranch &b, bool resolveDir) {
+    s.bht[b.historyIndex] = ((b.history << 1) | (resolveDir ? 1 : 0)) & kHistMask;
+  }
+
+  static void PipeCommit(State &s, const InFlightBranch &b, bool resolveDir, bool spec) {
+    s.pht.Update(b.index, resolveDir);
+    if (!spec) {
+      uint16_t &history = s.bht[b.historyIndex];
+      history = ((history << 1) | (resolveDir ? 1 : 0)) & kHistMask;
+    }
+  }
+
+  // the registered functions, on the current thread's State
+  static inline UINT32 CounterIndex(UINT32 PC) { return CounterIndex(tls, PC); }
+  static inline uint64_t PatternKey(UINT32 PC) { return PatternKey(tls, PC); }
+  static void Init() { Init(tls); }
+  static bool Get(UINT32 PC) { return Get(tls, PC); }
+  static void Update(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
+    Update(tls, PC, resolveDir, predDir, branchTarget);
+  }
+  static bool PipePredict(UINT32 PC, InFlightBranch *b, bool spec) { return PipePredict(tls, PC, b, spec); }
+  static void PipeRepair(const InFlightBranch &b, bool resolveDir) { PipeRepair(tls, b, resolveDir); }
+  static void PipeCommit(const InFlightBranch &b, bool resolveDir, bool spec) { PipeCommit(tls, b, resolveDir, spec); }
+
+  static void Save(PredictorState *out) {
+    SaveState(out, tls.bht);
+    SaveState(out, tls.pht);
+  }
+
+  static bool Restore(const PredictorState &in) {
+    size_t pos = 0;
+    return RestoreState(in, &pos, &tls.bht) && RestoreState(in, &pos, &tls.pht) && pos == in.size();
+  }
+};
+
+template <unsigned LogBht, unsigned BhtShift, unsigned HistBits, unsigned LogPht, unsigned CtrBits>
+thread_local typename PShare<LogBht, BhtShift, HistBits, LogPht, CtrBits>::State PShare<LogBht, BhtShift, HistBits, LogPht, CtrBits>::tls;
+
+#endif
@@ -0,0 +1,75 @@
+#include <algorithm>
+
+#include "profile.h"
+
+BranchProfile::BranchProfile(unsigned numPredictors)
+    : entries((size_t)1 << PROFILE_LOG_INITIAL, BranchProfileEntry()),
+      mispred(numPredictors, std::vector<UINT64>((size_t)1 << PROFILE_LOG_INITIAL, 0)),
+      logSize(PROFILE_LOG_INITIAL),
+      used(0) {}
+
+void BranchProfile::Grow(size_t minUsed) {
+  std::vector<BranchProfileEntry> oldEntries;
+  std::vector<std::vector<UINT64> > oldMispred;
+  oldEntries.swap(entries);
+  oldMispred.swap(mispred);
+
+  while (((size_t)1 << logSize) < minUsed * 2) {
+    logSize++;
+  }
+  size_t size = (size_t)1 << logSize;
+  size_t mask = size - 1;
+
+  entries.assign(size, BranchProfileEntry());
+  mispred.assign(oldMispred.size(), std::vector<UINT64>(size, 0));
+
+  for (size_t i = 0; i < oldEntries.size(); i++) {
+    if (oldEntries[i].execs == 0) {
+      continue;
+    }
+    size_t slot = Hash(oldEntries[i].PC, logSize);
+    while (entries[slot].execs != 0) {
+      slot = (slot + 1) & mask;
+    }
+    entries[slot] = oldEntries[i];
+    for (size_t p = 0; p < mispred.size(); p++) {
+      mispred[p][slot] = oldMispred[p][i];
+    }
+  }
+}
+
+void BranchProfile::Report(FILE *out, const std::vector<const char *> &names, unsigned numTop) const {
+  std::vector<size_t> slots;
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (entries[i].execs != 0) {
+      slots.push_back(i);
+    }
+  }
+
+  for (size_t p = 0; p < mispred.size(); p++) {
+    const std::vector<UINT64> &counts = mispred[p];
+    UINT64 total = 0;
+    for (size_t i = 0; i < slots.size(); i++) {
+      total += counts[slots[i]];
+    }
+
+    size_t n = std::min((size_t)numTop, slots.size());
+    std::partial_sort(slots.begin(), slots.begin() + n, slots.end(), [&counts](size_t a, size_t b) {
+      return counts[a] > counts[b];
+    });
+
+    fprintf(out, "  TOP_BRANCHES_%s (%zu static branches)\n", names[p], slots.size());
+    fprintf(out, "    %-10s %12s %12s %7s %7s %7s %7s\n", "PC", "EXECS", "MISPRED", "%MISP", "%TOTAL",
+            "TAKEN", "TRANS");
+    for (size_t k = 0; k < n; k++) {
+      const BranchProfileEntry &e = entries[slots[k]];
+      UINT64 m = counts[slots[k]];
+      if (m == 0) {
+        break;
+      }
+      fprintf(out, "    0x%08x %12llu %12llu %6.2f%% %6.2f%% %6.2f%% %6.2f%%\n", e.PC, (unsigned long long)e.execs,
+              (unsigned long long)m, 100.0 * m / e.execs, total ? 100.0 * m / total : 0.0,
+              100.0 * e.taken / e.execs, 100.0 * e.transitions / e.execs);
+    }
+  }
+}
@@ -0,0 +1,93 @@
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "utils.h"
+
+/////////////////////////////////////////////////////////////
+// per-branch profile
+/////////////////////////////////////////////////////////////
+/*
+Per static branch counters for one trace: executions, taken count,
+transitions (outcome differs from the previous execution of the same
+branch) and mispredictions of each selected predictor.
+
+Branches live in an open-addressing table (linear probing,
+Fibonacci hash of the PC) that doubles when it gets half full.
+The driver looks each conditional branch up once with Record and
+reuses the returned slot for every predictor, so the profile costs
+one probe per branch and one increment per misprediction.
+Slots only move when the table grows, which Reserve does up front
+for a whole chunk.
+*/
+
+#define PROFILE_LOG_INITIAL 16
+
+struct BranchProfileEntry {
+  UINT32 PC;
+  bool lastTaken;
+  UINT64 execs; // 0 marks an empty slot
+  UINT64 taken;
+  UINT64 transitions;
+};
+
+class BranchProfile {
+ public:
+  explicit BranchProfile(unsigned numPredictors);
+
+  // makes room for n more branches without moving any slot
+  void Reserve(size_t n) {
+    if ((used + n) * 2 > entries.size()) {
+      Grow(used + n);
+    }
+  }
+
+  // counts one execution of PC and returns its slot
+  inline size_t Record(UINT32 PC, bool taken) {
+    size_t mask = entries.size() - 1;
+    size_t slot = Hash(PC, logSize);
+    while (entries[slot].execs != 0 && entries[slot].PC != PC) {
+      slot = (slot + 1) & mask;
+    }
+
+    BranchProfileEntry &e = entries[slot];
+    if (e.execs == 0) {
+      e.PC = PC;
+      used++;
+    }
+    else if (e.lastTaken != taken) {
+      e.transitions++;
+    }
+    e.execs++;
+    e.taken += taken;
+    e.lastTaken = taken;
+    return slot;
+  }
+
+  inline void Mispredict(unsigned p, size_t slot) {
+    mispred[p][slot]++;
+  }
+
+  size_t NumBranches() const { return used; }
+
+  // top numTop branches by mispredictions of each predictor
+  void Report(FILE *out, const std::vector<const char *> &names, unsigned numTop) const;
+
+ private:
+  // top bits of a Fibonacci hash, the low PC bits are mostly zero
+  static inline size_t Hash(UINT32 PC, unsigned logSize) {
+    return (size_t)(((uint64_t)PC * 0x9E3779B97F4A7C15ull) >> (64 - logSize));
+  }
+
+  void Grow(size_t minUsed);
+
+  std::vector<BranchProfileEntry> entries;
+  std::vector<std::vector<UINT64> > mispred;
+  unsigned logSize;
+  size_t used;
+};
+
+#endif
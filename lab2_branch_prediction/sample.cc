@@ -0,0 +1,44 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "sample.h"
+
+bool ParseSampleConfig(const char *spec, SampleConfig *cfg) {
+  char *end;
+  cfg->period = strtoull(spec, &end, 10);
+  if (*end != ',') {
+    return false;
+  }
+  cfg->warm = strtoull(end + 1, &end, 10);
+  if (*end != ',') {
+    return false;
+  }
+  cfg->window = strtoull(end + 1, &end, 10);
+  return *end == '\0' && cfg->window > 0 && cfg->warm + cfg->window <= cfg->period;
+}
+
+void EstimateMpki(const SampleConfig &cfg, const SampleCounts &counts, size_t p, double *mean, double *ci95,
+                  size_t *numSamples) {
+  double sum = 0.0;
+  double sumSq = 0.0;
+  size_t n = 0;
+
+  for (size_t s = 0; s < counts.insts.size(); s++) {
+    // the last window of a trace may be cut short
+    if (counts.branches[s] != cfg.window || counts.insts[s] == 0) {
+      continue;
+    }
+    double mpki = 1000.0 * (double)counts.mispred[p][s] / (double)counts.insts[s];
+    sum += mpki;
+    sumSq += mpki * mpki;
+    n++;
+  }
+
+  *numSamples = n;
+  *mean = n ? sum / n : 0.0;
+  *ci95 = 0.0;
+  if (n > 1) {
+    double var = (sumSq - sum * sum / n) / (n - 1);
+    *ci95 = 1.96 * sqrt(var > 0.0 ? var : 0.0) / sqrt((double)n);
+  }
+}
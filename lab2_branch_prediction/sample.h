@@ -0,0 +1,60 @@
+#ifndef _SAMPLE_H_
+#define _SAMPLE_H_
+
+#include <vector>
+
+#include "utils.h"
+
+/////////////////////////////////////////////////////////////
+// sampled evaluation
+/////////////////////////////////////////////////////////////
+/*
+Systematic sampling over the conditional branches of a trace. Every
+period branches the predictors see
+
+  warm     branches trained but not counted (functional warm-up)
+  window   branches trained and counted (one sample)
+
+and skip the rest of the period. Skipped branches are still decoded
+but never reach the predictors, so a run costs about
+(warm + window) / period of a full one. Tables keep their contents
+across the skipped part, the warm-up only refreshes them.
+
+Each complete window gives one MPKI sample. The estimate is the mean
+of the samples with a 95% confidence interval of
+1.96 * stddev / sqrt(samples) (normal approximation, so it needs a
+few dozen samples to mean much).
+*/
+
+enum SamplePhase { SAMPLE_SKIP, SAMPLE_WARM, SAMPLE_MEASURE };
+
+struct SampleConfig {
+  UINT64 period;
+  UINT64 warm;
+  UINT64 window;
+};
+
+// parses <period>,<warm>,<window>, false on a syntax error
+bool ParseSampleConfig(const char *spec, SampleConfig *cfg);
+
+// phase of the conditional branch with index n in the trace
+static inline SamplePhase GetSamplePhase(const SampleConfig &cfg, UINT64 n) {
+  UINT64 pos = n % cfg.period;
+  if (pos < cfg.warm) {
+    return SAMPLE_WARM;
+  }
+  return pos < cfg.warm + cfg.window ? SAMPLE_MEASURE : SAMPLE_SKIP;
+}
+
+// per window counts of one trace
+struct SampleCounts {
+  std::vector<UINT64> insts;
+  std::vector<UINT64> branches;
+  std::vector<std::vector<UINT64> > mispred; // [predictor][sample]
+};
+
+// mean MPKI of predictor p over the complete windows and its 95% interval
+void EstimateMpki(const SampleConfig &cfg, const SampleCounts &counts, size_t p, double *mean, double *ci95,
+                  size_t *numSamples);
+
+#endif
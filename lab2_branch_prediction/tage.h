@@ -0,0 +1,448 @@
+#ifndef _TAGE_H_
+#define _TAGE_H_
+
+#include <math.h>
+#include <string.h>
+
+#include "utils.h"
+#include "packed_counters.h"
+#include "predictor_state.h"
+
+/////////////////////////////////////////////////////////////
+// TAGE
+/////////////////////////////////////////////////////////////
+/*
+A bimodal base predictor plus NumTables partially tagged tables
+indexed with geometric global history lengths between MinHist and
+MaxHist (Seznec and Michaud, "A case for (partially) TAgged GEometric
+history length branch prediction").
+
+  base         2^LogBase 2-bit counters indexed by PC
+  table i      2^LogTagged entries of {3-bit signed counter, 2-bit useful, TagBits tag}
+
+The prediction comes from the hitting table with the longest history
+(provider), or from the next hitting table / base (alternate) when the
+provider entry was just allocated and USE_ALT_ON_NA says so.
+On a misprediction one entry is allocated in a longer table whose
+useful counter is zero, otherwise the useful counters of the
+candidates are decremented. Useful counters are halved every
+TAGE_U_RESET_PERIOD branches.
+
+Each table keeps three folded (compressed) copies of its history
+length, one for the index and two for the tag, updated in O(1) per
+branch from the circular history buffer.
+The table sizes and history lengths are template parameters, so the
+storage budget is picked by the instance (see predictor.h and
+predictor_grid.cc).
+With delayed updates (pipeline.h) every branch keeps its lookup and the
+history pointer and folds it saw (InFlight), so a repair rewinds the
+folds and a commit trains what was read at predict time.
+*/
+
+#define TAGE_HIST_BUFFER 2048
+#define TAGE_U_RESET_PERIOD (1 << 18)
+
+struct TageEntry {
+  int8_t ctr;
+  uint8_t u;
+  uint16_t tag;
+};
+
+// history of Length bits folded into Width bits
+struct FoldedHistory {
+  UINT32 comp;
+  unsigned length;
+  unsigned width;
+  unsigned outPoint;
+
+  void Init(unsigned l, unsigned w) {
+    comp = 0;
+    length = l;
+    width = w;
+    outPoint = l % w;
+  }
+
+  // newest is the bit entering the history, oldest is the one leaving it
+  inline void Update(UINT32 newest, UINT32 oldest) {
+    comp = (comp << 1) | newest;
+    comp ^= oldest << outPoint;
+    comp ^= comp >> width;
+    comp &= (1u << width) - 1;
+  }
+};
+
+template <unsigned LogBase, unsigned LogTagged, unsigned NumTables, unsigned MinHist, unsigned MaxHist,
+          unsigned TagBits>
+struct Tage {
+  static_assert(MaxHist < TAGE_HIST_BUFFER, "history buffer too small");
+  static_assert(TagBits <= 16, "tags are stored in 16 bits");
+
+  static const UINT32 kBaseSize = 1u << LogBase;
+  static const UINT32 kTaggedSize = 1u << LogTagged;
+  static const UINT32 kTaggedMask = kTaggedSize - 1;
+  static const UINT32 kTagMask = (1u << TagBits) - 1;
+  static const UINT64 kStorageBits =
+      (UINT64)kBaseSize * 2 + (UINT64)NumTables * kTaggedSize * (3 + 2 + TagBits) + MaxHist + 16 + 4;
+
+  typedef PackedCounters<2, kBaseSize> BaseTable;
+
+  struct State {
+    BaseTable base;
+    TageEntry tables[NumTables][kTaggedSize];
+
+    // global history, ghist[ptr] is the newest outcome
+    uint8_t ghist[TAGE_HIST_BUFFER];
+    unsigned ptr;
+    UINT32 pathHist;
+    unsigned histLength[NumTables];
+    FoldedHistory indexFold[NumTables];
+    FoldedHistory tagFold0[NumTables];
+    FoldedHistory tagFold1[NumTables];
+
+    int useAltOnNa;
+    UINT32 tick;
+    UINT32 seed;
+
+    // lookup of the last predicted branch, reused by Update
+    bool lookupValid;
+    UINT32 lookupPC;
+    UINT32 index[NumTables];
+    UINT32 tag[NumTables];
+    int provider;
+    int altProvider;
+    bool providerPred;
+    bool altPred;
+    bool pred;
+  };
+
+  static thread_local State tls;
+
+  static inline UINT32 Index(const State &s, UINT32 PC, unsigned i) {
+    UINT32 path = s.pathHist & ((1u << (s.histLength[i] < 16 ? s.histLength[i] : 16)) - 1);
+    return (PC ^ (PC >> (i + 1)) ^ s.indexFold[i].comp ^ path ^ (path >> LogTagged)) & kTaggedMask;
+  }
+
+  static inline UINT32 Tag(const State &s, UINT32 PC, unsigned i) {
+    return (PC ^ s.tagFold0[i].comp ^ (s.tagFold1[i].comp << 1)) & kTagMask;
+  }
+
+  static inline bool BasePred(const State &s, UINT32 PC) {
+    return s.base.Taken(PC & (kBaseSize - 1));
+  }
+
+  static void Init(State &s) {
+    s.base.Fill(WEAK_NOT_TAKEN(2));
+    for (unsigned i = 0; i < NumTables; i++) {
+      for (UINT32 j = 0; j < kTaggedSize; j++) {
+        s.tables[i][j].ctr = 0;
+        s.tables[i][j].u = 0;
+        s.tables[i][j].tag = 0;
+      }
+    }
+
+    for (unsigned k = 0; k < TAGE_HIST_BUFFER; k++) {
+      s.ghist[k] = 0;
+    }
+    s.ptr = 0;
+    s.pathHist = 0;
+
+    // geometric history lengths
+    for (unsigned i = 0; i < NumTables; i++) {
+      double ratio = NumTables > 1 ? (double)i / (NumTables - 1) : 0.0;
+      s.histLength[i] = (unsigned)(MinHist * pow((double)MaxHist / MinHist, ratio) + 0.5);
+      s.indexFold[i].Init(s.histLength[i], LogTagged);
+      s.tagFold0[i].Init(s.histLength[i], TagBits);
+      s.tagFold1[i].Init(s.histLength[i], TagBits - 1);
+    }
+
+    s.useAltOnNa = 8;
+    s.tick = 0;
+    s.seed = 0x2545F491;
+    s.lookupValid = false;
+  }
+
+  static void Lookup(State &s, UINT32 PC) {
+    s.lookupValid = true;
+    s.lookupPC = PC;
+    s.provider = -1;
+    s.altProvider = -1;
+
+    for (unsigned i = 0; i < NumTables; i++) {
+      s.index[i] = Index(s, PC, i);
+      s.tag[i] = Tag(s, PC, i);
+    }
+
+    // longest and second longest hitting tables
+    for (int i = NumTables - 1; i >= 0; i--) {
+      if (s.tables[i][s.index[i]].tag == s.tag[i]) {
+        if (s.provider < 0) {
+          s.provider = i;
+        }
+        else {
+          s.altProvider = i;
+          break;
+        }
+      }
+    }
+
+    s.altPred = s.altProvider >= 0 ? s.tables[s.altProvider][s.index[s.altProvider]].ctr >= 0 : BasePred(s, PC);
+
+    if (s.provider < 0) {
+      s.providerPred = s.altPred;
+      s.pred = s.altPred;
+      return;
+    }
+
+    const TageEntry &entry = s.tables[s.provider][s.index[s.provider]];
+    s.providerPred = entry.ctr >= 0;
+
+    // newly allocated entries are not trusted when the alternate has been better
+    bool weak = (entry.ctr == 0 || entry.ctr == -1) && entry.u == 0;
+    s.pred = (weak && s.useAltOnNa >= 8) ? s.altPred : s.providerPred;
+  }
+
+  static bool Get(State &s, UINT32 PC) {
+    Lookup(s, PC);
+    return s.pred;
+  }
+
+  static inline void UpdateCtr(int8_t &ctr, bool resolveDir) {
+    if (resolveDir == TAKEN) {
+      if (ctr < 3) {
+        ctr++;
+      }
+    }
+    else {
+      if (ctr > -4) {
+        ctr--;
+      }
+    }
+  }
+
+  static inline UINT32 Random(State &s) {
+    s.seed ^= s.seed << 13;
+    s.seed ^= s.seed >> 17;
+    s.seed ^= s.seed << 5;
+    return s.seed;
+  }
+
+  static void Allocate(State &s, bool resolveDir) {
+    unsigned start = s.provider + 1;
+    if (start >= NumTables) {
+      return;
+    }
+
+    // skip a table now and then so allocations spread over the longer tables
+    if (start + 1 < NumTables && (Random(s) & 0x3) == 0) {
+      start++;
+    }
+
+    for (unsigned i = start; i < NumTables; i++) {
+      TageEntry &entry = s.tables[i][s.index[i]];
+      if (entry.u == 0) {
+        entry.tag = s.tag[i];
+        entry.ctr = resolveDir ? 0 : -1;
+        return;
+      }
+    }
+
+    // no free entry, age the candidates
+    for (unsigned i = start; i < NumTables; i++) {
+      TageEntry &entry = s.tables[i][s.index[i]];
+      if (entry.u > 0) {
+        entry.u--;
+      }
+    }
+  }
+
+  static void UpdateHistory(State &s, UINT32 PC, bool resolveDir) {
+    s.ptr = (s.ptr - 1) & (TAGE_HIST_BUFFER - 1);
+    s.ghist[s.ptr] = resolveDir ? 1 : 0;
+    s.pathHist = ((s.pathHist << 1) | (PC & 0x1)) & 0xFFFF;
+
+    for (unsigned i = 0; i < NumTables; i++) {
+      UINT32 oldest = s.ghist[(s.ptr + s.histLength[i]) & (TAGE_HIST_BUFFER - 1)];
+      s.indexFold[i].Update(s.ghist[s.ptr], oldest);
+      s.tagFold0[i].Update(s.ghist[s.ptr], oldest);
+      s.tagFold1[i].Update(s.ghist[s.ptr], oldest);
+    }
+  }
+
+  // trains the provider, alternate, base and useful counters on the lookup in s
+  static void Train(State &s, UINT32 PC, bool resolveDir) {
+    if (s.provider >= 0) {
+      TageEntry &entry = s.tables[s.provider][s.index[s.provider]];
+
+      // learn whether newly allocated entries should be trusted
+      bool weak = (entry.ctr == 0 || entry.ctr == -1) && entry.u == 0;
+      if (weak && s.providerPred != s.altPred) {
+        if (s.altPred == resolveDir) {
+          if (s.useAltOnNa < 15) {
+            s.useAltOnNa++;
+          }
+        }
+        else if (s.useAltOnNa > 0) {
+          s.useAltOnNa--;
+        }
+      }
+
+      UpdateCtr(entry.ctr, resolveDir);
+
+      // the alternate is trained too while the provider is still weak
+      if (weak) {
+        if (s.altProvider >= 0) {
+          UpdateCtr(s.tables[s.altProvider][s.index[s.altProvider]].ctr, resolveDir);
+        }
+        else {
+          s.base.Update(PC & (kBaseSize - 1), resolveDir);
+        }
+      }
+
+      if (s.providerPred != s.altPred) {
+        if (s.providerPred == resolveDir) {
+          if (entry.u < 3) {
+            entry.u++;
+          }
+        }
+        else if (entry.u > 0) {
+          entry.u--;
+        }
+      }
+    }
+    else {
+      s.base.Update(PC & (kBaseSize - 1), resolveDir);
+    }
+
+    if (s.pred != resolveDir) {
+      Allocate(s, resolveDir);
+    }
+
+    // graceful reset of the useful counters
+    if (++s.tick == TAGE_U_RESET_PERIOD) {
+      s.tick = 0;
+      for (unsigned i = 0; i < NumTables; i++) {
+        for (UINT32 j = 0; j < kTaggedSize; j++) {
+          s.tables[i][j].u >>= 1;
+        }
+      }
+    }
+  }
+
+  static void Update(State &s, UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
+    if (!s.lookupValid || s.lookupPC != PC) {
+      Lookup(s, PC);
+    }
+    Train(s, PC, resolveDir);
+    UpdateHistory(s, PC, resolveDir);
+
+    // the history changed, the next branch needs a new lookup
+    s.lookupValid = false;
+  }
+
+  // the lookup of a predicted branch and the history it saw, kept in
+  // InFlightBranch::detail until the branch is repaired or committed
+  struct InFlight {
+    UINT32 index[NumTables];
+    UINT32 tag[NumTables];
+    int provider;
+    int altProvider;
+    bool providerPred;
+    bool altPred;
+    bool pred;
+
+    unsigned ptr;
+    UINT32 pathHist;
+    UINT32 indexComp[NumTables];
+    UINT32 tagComp0[NumTables];
+    UINT32 tagComp1[NumTables];
+  };
+
+  static bool PipePredict(State &s, UINT32 PC, InFlightBranch *b, bool spec) {
+    Lookup(s, PC);
+    s.lookupValid = false;
+
+    InFlight f;
+    memcpy(f.index, s.index, sizeof(f.index));
+    memcpy(f.tag, s.tag, sizeof(f.tag));
+    f.provider = s.provider;
+    f.altProvider = s.altProvider;
+    f.providerPred = s.providerPred;
+    f.altPred = s.altPred;
+    f.pred = s.pred;
+
+    // only the pointer and the folds move, the buffer entries older than ptr stay
+    f.ptr = s.ptr;
+    f.pathHist = s.pathHist;
+    for (unsigned i = 0; i < NumTables; i++) {
+      f.indexComp[i] = s.indexFold[i].comp;
+      f.tagComp0[i] = s.tagFold0[i].comp;
+      f.tagComp1[i] = s.tagFold1[i].comp;
+    }
+    SaveState(&b->detail, f);
+
+    if (spec) {
+      UpdateHistory(s, PC, s.pred);
+    }
+    return f.pred;
+  }
+
+  static void PipeRepair(State &s, const InFlightBranch &b, bool resolveDir) {
+    InFlight f;
+    size_t pos = 0;
+    RestoreState(b.detail, &pos, &f);
+
+    s.ptr = f.ptr;
+    s.pathHist = f.pathHist;
+    for (unsigned i = 0; i < NumTables; i++) {
+      s.indexFold[i].comp = f.indexComp[i];
+      s.tagFold0[i].comp = f.tagComp0[i];
+      s.tagFold1[i].comp = f.tagComp1[i];
+    }
+    UpdateHistory(s, b.PC, resolveDir);
+  }
+
+  static void PipeCommit(State &s, const InFlightBranch &b, bool resolveDir, bool spec) {
+    InFlight f;
+    size_t pos = 0;
+    RestoreState(b.detail, &pos, &f);
+
+    memcpy(s.index, f.index, sizeof(s.index));
+    memcpy(s.tag, f.tag, sizeof(s.tag));
+    s.provider = f.provider;
+    s.altProvider = f.altProvider;
+    s.providerPred = f.providerPred;
+    s.altPred = f.altPred;
+    s.pred = f.pred;
+    Train(s, b.PC, resolveDir);
+
+    if (!spec) {
+      UpdateHistory(s, b.PC, resolveDir);
+    }
+  }
+
+  // the registered functions, on the current thread's State
+  static void Init() { Init(tls); }
+  static bool Get(UINT32 PC) { return Get(tls, PC); }
+  static void Update(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
+    Update(tls, PC, resolveDir, predDir, branchTarget);
+  }
+  static bool PipePredict(UINT32 PC, InFlightBranch *b, bool spec) { return PipePredict(tls, PC, b, spec); }
+  static void PipeRepair(const InFlightBranch &b, bool resolveDir) { PipeRepair(tls, b, resolveDir); }
+  static void PipeCommit(const InFlightBranch &b, bool resolveDir, bool spec) { PipeCommit(tls, b, resolveDir, spec); }
+
+  static void Save(PredictorState *out) {
+    SaveState(out, tls);
+  }
+
+  static bool Restore(const PredictorState &in) {
+    size_t pos = 0;
+    return RestoreState(in, &pos, &tls) && pos == in.size();
+  }
+};
+
+template <unsigned LogBase, unsigned LogTagged, unsigned NumTables, unsigned MinHist, unsigned MaxHist,
+          unsigned TagBits>
+thread_local typename Tage<LogBase, LogTagged, NumTables, MinHist, MaxHist, TagBits>::State
+    Tage<LogBase, LogTagged, NumTables, MinHist, MaxHist, TagBits>::tls;
+
+#endif
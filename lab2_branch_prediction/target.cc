@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "target.h"
+
+/////////////////////////////////////////////////////////////
+// configuration
+/////////////////////////////////////////////////////////////
+
+bool ParseTargetConfig(const char *spec, TargetConfig *cfg) {
+  cfg->replacement = BTB_LRU;
+  cfg->rasDepth = 16;
+
+  char *end;
+  cfg->sets = strtoul(spec, &end, 10);
+  if (*end != 'x') {
+    return false;
+  }
+  cfg->ways = strtoul(end + 1, &end, 10);
+
+  if (*end == ':') {
+    const char *policy = end + 1;
+    size_t len = strcspn(policy, ",");
+    if (len == 3 && strncmp(policy, "lru", len) == 0) {
+      cfg->replacement = BTB_LRU;
+    }
+    else if (len == 4 && strncmp(policy, "fifo", len) == 0) {
+      cfg->replacement = BTB_FIFO;
+    }
+    else if (len == 6 && strncmp(policy, "random", len) == 0) {
+      cfg->replacement = BTB_RANDOM;
+    }
+    else {
+      return false;
+    }
+    end = (char *)policy + len;
+  }
+
+  if (*end == ',') {
+    cfg->rasDepth = strtoul(end + 1, &end, 10);
+  }
+
+  // the set index is a mask, so sets must be a power of two
+  return *end == '\0' && cfg->sets > 0 && (cfg->sets & (cfg->sets - 1)) == 0 && cfg->ways > 0;
+}
+
+std::string TargetConfigName(const TargetConfig &cfg) {
+  static const char *policies[] = {"lru", "fifo", "random"};
+  char name[64];
+  snprintf(name, sizeof(name), "btb-%ux%u-%s-ras%u", cfg.sets, cfg.ways, policies[cfg.replacement],
+           cfg.rasDepth);
+  return name;
+}
+
+/////////////////////////////////////////////////////////////
+// BTB and RAS
+/////////////////////////////////////////////////////////////
+
+TargetPredictor::TargetPredictor(const TargetConfig &c)
+    : cfg(c), btb((size_t)c.sets * c.ways), clock(0), seed(0x2545F491), ras(c.rasDepth), rasTop(0), rasCount(0) {
+  for (size_t i = 0; i < btb.size(); i++) {
+    btb[i].valid = false;
+  }
+  memset(&stats, 0, sizeof(stats));
+}
+
+TargetPredictor::BtbEntry *TargetPredictor::Lookup(UINT32 PC) {
+  UINT32 set = (PC ^ (PC >> 12)) & (cfg.sets - 1);
+  BtbEntry *ways = &btb[(size_t)set * cfg.ways];
+  for (unsigned w = 0; w < cfg.ways; w++) {
+    if (ways[w].valid && ways[w].tag == PC) {
+      if (cfg.replacement == BTB_LRU) {
+        ways[w].age = ++clock;
+      }
+      return &ways[w];
+    }
+  }
+  return NULL;
+}
+
+void TargetPredictor::Insert(UINT32 PC, UINT32 target) {
+  UINT32 set = (PC ^ (PC >> 12)) & (cfg.sets - 1);
+  BtbEntry *ways = &btb[(size_t)set * cfg.ways];
+
+  // an invalid way first, then the policy's victim
+  BtbEntry *victim = NULL;
+  for (unsigned w = 0; w < cfg.ways && victim == NULL; w++) {
+    if (!ways[w].valid) {
+      victim = &ways[w];
+    }
+  }
+  if (victim == NULL) {
+    if (cfg.replacement == BTB_RANDOM) {
+      seed ^= seed << 13;
+      seed ^= seed >> 17;
+      seed ^= seed << 5;
+      victim = &ways[seed % cfg.ways];
+    }
+    else {
+      // oldest use (LRU) or oldest insertion (FIFO)
+      victim = &ways[0];
+      for (unsigned w = 1; w < cfg.ways; w++) {
+        if (ways[w].age < victim->age) {
+          victim = &ways[w];
+        }
+      }
+    }
+  }
+
+  victim->valid = true;
+  victim->tag = PC;
+  victim->target = target;
+  victim->age = ++clock;
+}
+
+void TargetPredictor::Push(UINT32 PC) {
+  if (cfg.rasDepth == 0) {
+    return;
+  }
+  if (rasCount == cfg.rasDepth) {
+    stats.rasOverflow++;
+  }
+  else {
+    rasCount++;
+  }
+  ras[rasTop] = PC;
+  rasTop = (rasTop + 1) % cfg.rasDepth;
+}
+
+bool TargetPredictor::Pop(UINT32 *PC) {
+  if (rasCount == 0) {
+    stats.rasUnderflow++;
+    return false;
+  }
+  rasCount--;
+  rasTop = (rasTop + cfg.rasDepth - 1) % cfg.rasDepth;
+  *PC = ras[rasTop];
+  return true;
+}
+
+void TargetPredictor::Process(const BranchRecord &rec) {
+  if (rec.opType == OPTYPE_OP || (rec.opType == OPTYPE_BRANCH_COND && !rec.taken)) {
+    return;
+  }
+  stats.numTakenBr++;
+
+  bool correct;
+  if (rec.opType == OPTYPE_RET) {
+    stats.numReturns++;
+    UINT32 callPC;
+    if (Pop(&callPC)) {
+      correct = rec.branchTarget > callPC && rec.branchTarget - callPC <= TARGET_CALL_RETURN_WINDOW;
+      stats.rasWrong += !correct;
+      stats.numMispred += !correct;
+      return;
+    }
+  }
+
+  BtbEntry *entry = Lookup(rec.PC);
+  if (entry == NULL) {
+    stats.btbMiss++;
+    correct = false;
+    Insert(rec.PC, rec.branchTarget);
+  }
+  else {
+    correct = entry->target == rec.branchTarget;
+    stats.btbWrong += !correct;
+    entry->target = rec.branchTarget;
+  }
+  stats.numMispred += !correct;
+
+  if (rec.opType == OPTYPE_CALL_DIRECT || rec.opType == OPTYPE_INDIRECT_BR_CALL) {
+    Push(rec.PC);
+  }
+}
@@ -0,0 +1,96 @@
+#ifndef _TARGET_H_
+#define _TARGET_H_
+
+#include <string>
+#include <vector>
+
+#include "bpsim.h"
+
+/////////////////////////////////////////////////////////////
+// target prediction
+/////////////////////////////////////////////////////////////
+/*
+A set-associative branch target buffer plus a return address stack,
+trained from branchTarget of every taken branch.
+
+  BTB   Sets x Ways entries of {PC tag, target}, indexed by the PC,
+        full PC tags, replacement LRU, FIFO or random.
+        Allocated and updated by taken branches only, a not taken
+        conditional branch needs no target.
+  RAS   Depth entries. Calls push, returns pop and predict, a full
+        stack drops its oldest entry (overflow), a return on an
+        empty stack falls back to the BTB (underflow).
+
+The traces only carry the PC of each branch, not its length, so the
+stack holds the PC of the call and a return counts as correctly
+predicted when its target lies within TARGET_CALL_RETURN_WINDOW bytes
+after that call.
+OPTYPE_CALL_DIRECT and OPTYPE_INDIRECT_BR_CALL push, the trace format
+does not tell indirect jumps from indirect calls.
+A taken branch has a target misprediction when the predicted target
+is missing or wrong.
+*/
+
+#define TARGET_CALL_RETURN_WINDOW 16
+
+enum BtbReplacement { BTB_LRU, BTB_FIFO, BTB_RANDOM };
+
+struct TargetConfig {
+  UINT32 sets;
+  unsigned ways;
+  BtbReplacement replacement;
+  unsigned rasDepth;
+};
+
+// parses <sets>x<ways>[:lru|fifo|random][,<ras depth>], false on a syntax error
+bool ParseTargetConfig(const char *spec, TargetConfig *cfg);
+
+// btb-<sets>x<ways>-<policy>-ras<depth>
+std::string TargetConfigName(const TargetConfig &cfg);
+
+struct TargetStats {
+  UINT64 numTakenBr;
+  UINT64 numMispred;
+  UINT64 btbMiss;
+  UINT64 btbWrong;
+  UINT64 numReturns;
+  UINT64 rasWrong;
+  UINT64 rasOverflow;
+  UINT64 rasUnderflow;
+};
+
+class TargetPredictor {
+ public:
+  explicit TargetPredictor(const TargetConfig &cfg);
+
+  // predicts and trains on one record, non-branch records are ignored
+  void Process(const BranchRecord &rec);
+
+  const TargetStats &Stats() const { return stats; }
+
+ private:
+  struct BtbEntry {
+    bool valid;
+    UINT32 tag;
+    UINT32 target;
+    UINT64 age; // LRU timestamp or FIFO insertion order
+  };
+
+  BtbEntry *Lookup(UINT32 PC);
+  void Insert(UINT32 PC, UINT32 target);
+  void Push(UINT32 PC);
+  bool Pop(UINT32 *PC);
+
+  TargetConfig cfg;
+  std::vector<BtbEntry> btb;
+  UINT64 clock;
+  UINT32 seed;
+
+  std::vector<UINT32> ras;
+  unsigned rasTop;
+  unsigned rasCount;
+
+  TargetStats stats;
+};
+
+#endif
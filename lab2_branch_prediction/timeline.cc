@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "timeline.h"
+
+bool ParseTimelineConfig(char *spec, TimelineConfig *cfg) {
+  char *end;
+  cfg->interval = strtoull(spec, &end, 10);
+  cfg->dir = NULL;
+  if (*end == ',') {
+    *end = '\0';
+    cfg->dir = end + 1;
+    return cfg->interval > 0 && *cfg->dir != '\0';
+  }
+  return *end == '\0' && cfg->interval > 0;
+}
+
+MpkiTimeline::MpkiTimeline(const TimelineConfig &c, size_t numPredictors)
+    : cfg(c), numInsts(0), insts(1, 0), mispred(numPredictors, std::vector<UINT64>(1, 0)), out(NULL), written(0) {}
+
+MpkiTimeline::~MpkiTimeline() {
+  if (out != NULL) {
+    fclose(out);
+  }
+}
+
+bool MpkiTimeline::Open(const char *trace, const std::vector<const char *> &names) {
+  if (cfg.dir == NULL) {
+    return true;
+  }
+  const char *base = strrchr(trace, '/');
+  std::string path = std::string(cfg.dir) + "/" + (base ? base + 1 : trace) + ".mpki.csv";
+  out = fopen(path.c_str(), "w");
+  if (out == NULL) {
+    fprintf(stderr, "timeline: cannot create %s\n", path.c_str());
+    return false;
+  }
+  fprintf(out, "interval,start_inst,insts");
+  for (size_t p = 0; p < names.size(); p++) {
+    fprintf(out, ",%s", names[p]);
+  }
+  fprintf(out, "\n");
+  return true;
+}
+
+size_t MpkiTimeline::Advance(UINT32 instGap) {
+  UINT64 start = numInsts;
+  numInsts += instGap;
+
+  // a long gap fills every interval it crosses
+  while (insts.size() * cfg.interval < numInsts) {
+    insts.push_back(0);
+    for (size_t p = 0; p < mispred.size(); p++) {
+      mispred[p].push_back(0);
+    }
+  }
+  for (size_t k = start / cfg.interval; k < insts.size() && k * cfg.interval < numInsts; k++) {
+    UINT64 lo = k * cfg.interval > start ? k * cfg.interval : start;
+    UINT64 hi = (k + 1) * cfg.interval < numInsts ? (k + 1) * cfg.interval : numInsts;
+    insts[k] += hi - lo;
+  }
+  return numInsts ? (numInsts - 1) / cfg.interval : 0;
+}
+
+double MpkiTimeline::Mpki(size_t p, size_t k) const {
+  return insts[k] ? 1000.0 * (double)mispred[p][k] / (double)insts[k] : 0.0;
+}
+
+void MpkiTimeline::Flush(bool end) {
+  if (out == NULL) {
+    return;
+  }
+  size_t complete = end ? insts.size() : numInsts / cfg.interval;
+  for (; written < complete && written < insts.size(); written++) {
+    fprintf(out, "%zu,%llu,%llu", written, (unsigned long long)(written * cfg.interval),
+            (unsigned long long)insts[written]);
+    for (size_t p = 0; p < mispred.size(); p++) {
+      fprintf(out, ",%.4f", Mpki(p, written));
+    }
+    fprintf(out, "\n");
+  }
+  fflush(out);
+}
+
+std::string MpkiTimeline::Report(size_t p) const {
+  size_t n = numInsts / cfg.interval;
+  char buf[256];
+  if (n < TIMELINE_MIN_INTERVALS) {
+    snprintf(buf, sizeof(buf), "    warm-up: %zu complete intervals of %llu insts, too few to tell\n", n,
+             (unsigned long long)cfg.interval);
+    return buf;
+  }
+
+  // MSER from the back, so each truncation point costs O(1)
+  size_t best = 0;
+  double bestScore = 0.0;
+  double bestMean = 0.0;
+  double sum = 0.0;
+  double sumSq = 0.0;
+  for (size_t d = n; d-- > 0;) {
+    double x = Mpki(p, d);
+    sum += x;
+    sumSq += x * x;
+    if (d > n / 2) {
+      continue;
+    }
+    double m = (double)(n - d);
+    double mean = sum / m;
+    double score = (sumSq - m * mean * mean) / (m * m);
+    if (d == n / 2 || score <= bestScore) {
+      best = d;
+      bestScore = score;
+      bestMean = mean;
+    }
+  }
+
+  snprintf(buf, sizeof(buf),
+           "    warm-up: %zu of %zu intervals (%llu insts), steady-state MPKI %.4f, first interval %.4f\n", best, n,
+           (unsigned long long)(best * cfg.interval), bestMean, Mpki(p, 0));
+  return buf;
+}
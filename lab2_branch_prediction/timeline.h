@@ -0,0 +1,79 @@
+#ifndef _TIMELINE_H_
+#define _TIMELINE_H_
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "utils.h"
+
+/////////////////////////////////////////////////////////////
+// interval MPKI timeline
+/////////////////////////////////////////////////////////////
+/*
+Mispredictions of every selected predictor per fixed interval of
+instructions, to see phase changes the aggregate MPKI hides.
+A branch belongs to the interval its last instruction falls in.
+
+With an output directory every interval is appended to
+<dir>/<trace>.mpki.csv as soon as the trace has run past its end:
+
+  interval,start_inst,insts,<pred 1>,<pred 2>,...
+
+one MPKI column per predictor, so a long trace can be watched while it
+runs. The last row is the partial interval at the end of the trace.
+
+Warm-up is estimated per predictor with MSER (White, "An effective
+truncation heuristic for bias reduction in simulation output"): over
+the complete intervals x_0..x_n-1, the truncation point d <= n/2 that
+minimizes
+
+  sum_{k>=d} (x_k - mean_d)^2 / (n - d)^2
+
+where mean_d is the mean of x_d..x_n-1. Intervals before d are
+warm-up, mean_d is the steady-state MPKI. It needs at least
+TIMELINE_MIN_INTERVALS complete intervals.
+*/
+
+#define TIMELINE_MIN_INTERVALS 4
+
+struct TimelineConfig {
+  UINT64 interval;
+  const char *dir; // NULL: no streaming
+};
+
+// parses <interval insts>[,<dir>], false on a syntax error
+bool ParseTimelineConfig(char *spec, TimelineConfig *cfg);
+
+class MpkiTimeline {
+ public:
+  MpkiTimeline(const TimelineConfig &cfg, size_t numPredictors);
+  ~MpkiTimeline();
+
+  // starts streaming to <dir>/<trace>.mpki.csv, false if it cannot be created
+  bool Open(const char *trace, const std::vector<const char *> &names);
+
+  // interval of the next record, called once per record in trace order
+  size_t Advance(UINT32 instGap);
+
+  inline void Mispredict(size_t p, size_t interval) { mispred[p][interval]++; }
+
+  // writes the intervals that are complete, or all of them at the end
+  void Flush(bool end);
+
+  // warm-up line of predictor p
+  std::string Report(size_t p) const;
+
+ private:
+  double Mpki(size_t p, size_t k) const;
+
+  TimelineConfig cfg;
+  UINT64 numInsts;
+  std::vector<UINT64> insts;                 // [interval]
+  std::vector<std::vector<UINT64> > mispred; // [predictor][interval]
+  FILE *out;
+  size_t written;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include <thread>
+
+#include "work_pool.h"
+
+WorkStealingPool::WorkStealingPool(unsigned numThreads) : queues(numThreads > 0 ? numThreads : 1), numStolen(0) {}
+
+bool WorkStealingPool::Take(unsigned self, size_t *job) {
+  {
+    Queue &own = queues[self];
+    std::lock_guard<std::mutex> guard(own.lock);
+    if (!own.jobs.empty()) {
+      *job = own.jobs.front();
+      own.jobs.pop_front();
+      return true;
+    }
+  }
+
+  // own deque is empty, steal from the others starting with the next worker
+  for (unsigned k = 1; k < queues.size(); k++) {
+    Queue &victim = queues[(self + k) % queues.size()];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if (!victim.jobs.empty()) {
+      *job = victim.jobs.back();
+      victim.jobs.pop_back();
+      std::lock_guard<std::mutex> stats(statsLock);
+      numStolen++;
+      return true;
+    }
+  }
+  // no job is ever added during a Run, so all deques empty means done
+  return false;
+}
+
+void WorkStealingPool::Worker(unsigned self, const std::function<void(size_t)> &job) {
+  size_t j;
+  while (Take(self, &j)) {
+    job(j);
+  }
+}
+
+void WorkStealingPool::Run(size_t numJobs, const std::function<void(size_t)> &job) {
+  numStolen = 0;
+  for (size_t j = 0; j < numJobs; j++) {
+    queues[j % queues.size()].jobs.push_back(j);
+  }
+
+  std::vector<std::thread> threads;
+  for (unsigned w = 1; w < queues.size() && w < numJobs; w++) {
+    threads.push_back(std::thread(&WorkStealingPool::Worker, this, w, std::cref(job)));
+  }
+  Worker(0, job);
+  for (size_t w = 0; w < threads.size(); w++) {
+    threads[w].join();
+  }
+}
@@ -0,0 +1,50 @@
+#ifndef _WORK_POOL_H_
+#define _WORK_POOL_H_
+
+#include <stddef.h>
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/////////////////////////////////////////////////////////////
+// work-stealing pool
+/////////////////////////////////////////////////////////////
+/*
+Runs jobs 0..n-1 on a fixed set of threads. The jobs are dealt round
+robin into one deque per worker; a worker takes jobs from the front of
+its own deque and, once it is empty, steals from the back of the
+others. Jobs of very different length (a big predictor on a long
+trace next to a bimodal on a short one) then still keep every thread
+busy until the last job, unlike a static split.
+Job i should be the longest of the ones after it when the caller can
+tell, the tail of each deque is what gets stolen.
+*/
+
+class WorkStealingPool {
+ public:
+  explicit WorkStealingPool(unsigned numThreads);
+
+  // calls job(i) once for every i < numJobs, returns when all are done;
+  // the calling thread is one of the workers
+  void Run(size_t numJobs, const std::function<void(size_t)> &job);
+
+  // jobs taken from another worker's deque during the last Run
+  size_t NumStolen() const { return numStolen; }
+
+ private:
+  struct Queue {
+    std::mutex lock;
+    std::deque<size_t> jobs;
+  };
+
+  bool Take(unsigned self, size_t *job);
+  void Worker(unsigned self, const std::function<void(size_t)> &job);
+
+  std::vector<Queue> queues;
+  std::mutex statsLock;
+  size_t numStolen;
+};
+
+#endif
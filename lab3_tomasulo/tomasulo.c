@@ -2,9 +2,13 @@
 #include <limits.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include "host.h"
 #include "misc.h"
@@ -20,8 +24,10 @@
 #include "decode.def"
 
 #include "instr.h"
+#include "tomasulo.h"
 
 /* PARAMETERS OF THE TOMASULO'S ALGORITHM */
+// defaults of the -tom:* options
 #define INSTR_QUEUE_SIZE 16 // (10)
 
 #define RESERV_INT_SIZE 5 // (4)
@@ -32,6 +38,34 @@
 #define FU_INT_LATENCY 5 // (4)
 #define FU_FP_LATENCY 7  // (9)
 
+// instructions per cycle into the IFQ, IFQ to RS and RS to FU (0 = no limit)
+#define FETCH_WIDTH 1
+#define DISPATCH_WIDTH 1
+#define ISSUE_WIDTH 0
+// common data buses, each broadcasts one result per cycle
+#define NUM_CDBS 1
+
+// reorder buffer entries (0 = no reorder buffer) and instructions committed per cycle
+#define ROB_SIZE 0
+#define COMMIT_WIDTH 1
+// direction predictor steering fetch, needs a reorder buffer unless perfect
+#define BPRED "perfect"
+// cycles from resolving a mispredicted branch to fetching the correct path
+#define REDIRECT_PENALTY 3
+// cycles a conditional branch takes to resolve in the branch unit, with a reorder buffer
+#define BRANCH_LATENCY 1
+
+// load and store queue entries (0 and 0 = no load/store queue, needs a reorder buffer)
+#define LQ_SIZE 0
+#define SQ_SIZE 0
+// loads issue past stores whose address is unknown (0 = wait for every older store)
+#define SPEC_LOADS 0
+// latency of a load served by an older store in the store queue
+#define FORWARD_LATENCY 1
+
+// largest value accepted for any of the parameters above
+#define TOM_PARAM_MAX 4096
+
 /* IDENTIFYING INSTRUCTIONS */
 
 // unconditional branch, jump or call
@@ -74,250 +108,773 @@
   md_print_insn(instr->inst, instr->pc, out); \
   myfprintf(stdout, "(%d)\n", instr->index);
 
-/* VARIABLES */
+/* ECE552 Assignment 3 - BEGIN CODE */
+enum fu_type
+{
+  INT,
+  FP,
+  BR // conditional branches with a reorder buffer, no RS or FU limit
+};
 
-// instruction queue for tomasulo
-static instruction_t *instr_queue[INSTR_QUEUE_SIZE];
-// number of instructions in the instruction queue
-static int instr_queue_size = 0;
+/* MACHINE CONFIGURATION */
+typedef struct
+{
+  int ifq_size;
+  int rs_size[2];    // per fu_type
+  int fu_size[2];    // per fu_type
+  int fu_latency[2]; // per fu_type
+  int fetch_width;
+  int dispatch_width;
+  int issue_width; // 0: no limit
+  int num_cdbs;
+  int rob_size; // 0: no reorder buffer
+  int commit_width;
+  int redirect_penalty;
+  int br_latency;
+  int lq_size; // 0: no load/store queue
+  int sq_size;
+  int spec_loads;
+  int fwd_latency;
+  // not a sweep parameter
+  char *bpred;
+} tomasulo_config_t;
+
+// names, minimums and offsets of the int tomasulo_config_t fields, as in -tom:<name> and -tom:sweep
+static const char *tom_param_name[] = {"ifq", "rs_int", "rs_fp", "fu_int", "fu_fp", "lat_int", "lat_fp",
+                                       "fetch_width", "dispatch_width", "issue_width", "cdbs",
+                                       "rob", "commit_width", "redirect_penalty", "lat_br",
+                                       "lq", "sq", "spec_loads", "lat_fwd"};
+static const int tom_param_min[] = {1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 0, 1, 0, 1, 0, 0, 0, 1};
+static const size_t tom_param_offset[] = {
+    offsetof(tomasulo_config_t, ifq_size),
+    offsetof(tomasulo_config_t, rs_size[INT]), offsetof(tomasulo_config_t, rs_size[FP]),
+    offsetof(tomasulo_config_t, fu_size[INT]), offsetof(tomasulo_config_t, fu_size[FP]),
+    offsetof(tomasulo_config_t, fu_latency[INT]), offsetof(tomasulo_config_t, fu_latency[FP]),
+    offsetof(tomasulo_config_t, fetch_width), offsetof(tomasulo_config_t, dispatch_width),
+    offsetof(tomasulo_config_t, issue_width), offsetof(tomasulo_config_t, num_cdbs),
+    offsetof(tomasulo_config_t, rob_size), offsetof(tomasulo_config_t, commit_width),
+    offsetof(tomasulo_config_t, redirect_penalty), offsetof(tomasulo_config_t, br_latency),
+    offsetof(tomasulo_config_t, lq_size), offsetof(tomasulo_config_t, sq_size),
+    offsetof(tomasulo_config_t, spec_loads), offsetof(tomasulo_config_t, fwd_latency)};
+
+#define TOM_NUM_PARAMS (int)(sizeof(tom_param_name) / sizeof(tom_param_name[0]))
+
+// -tom:* option values, the defaults hold when the options are not registered
+static tomasulo_config_t tom_config = {
+    .ifq_size = INSTR_QUEUE_SIZE,
+    .rs_size = {RESERV_INT_SIZE, RESERV_FP_SIZE},
+    .fu_size = {FU_INT_SIZE, FU_FP_SIZE},
+    .fu_latency = {FU_INT_LATENCY, FU_FP_LATENCY},
+    .fetch_width = FETCH_WIDTH,
+    .dispatch_width = DISPATCH_WIDTH,
+    .issue_width = ISSUE_WIDTH,
+    .num_cdbs = NUM_CDBS,
+    .rob_size = ROB_SIZE,
+    .commit_width = COMMIT_WIDTH,
+    .redirect_penalty = REDIRECT_PENALTY,
+    .br_latency = BRANCH_LATENCY,
+    .lq_size = LQ_SIZE,
+    .sq_size = SQ_SIZE,
+    .spec_loads = SPEC_LOADS,
+    .fwd_latency = FORWARD_LATENCY,
+    .bpred = BPRED,
+};
+static char *tom_sweep = NULL;
+static int tom_threads = 0;
+static int tom_stream = FALSE;
+
+// statistics of the -tom:* run
+static counter_t tom_num_cond_branches = 0;
+static counter_t tom_num_mispred = 0;
+static counter_t tom_num_load_forwards = 0;
+static counter_t tom_num_mem_violations = 0;
+static counter_t tom_num_squashed = 0;
+
+/* DIRECTION PREDICTORS */
+/*
+ * Same interface as the lab 2 predictors, with the predictor state held
+ * by the machine so the runs of a sweep do not share tables. get == NULL
+ * is the perfect predictor. The trace only holds the committed path, so
+ * the outcome of a conditional branch is whether the next instruction in
+ * the trace is its fall-through, and predictors are updated at fetch.
+ */
+typedef struct
+{
+  const char *name;
+  void *(*init)(void);
+  bool (*get)(void *state, md_addr_t PC);
+  void (*update)(void *state, md_addr_t PC, bool resolveDir, bool predDir, md_addr_t branchTarget);
+} tom_bpred_t;
+
+void *bpred_static_init(void);
+bool bpred_taken_get(void *state, md_addr_t PC);
+bool bpred_nottaken_get(void *state, md_addr_t PC);
+void bpred_static_update(void *state, md_addr_t PC, bool resolveDir, bool predDir, md_addr_t branchTarget);
+void *bpred_2bitsat_init(void);
+bool bpred_2bitsat_get(void *state, md_addr_t PC);
+void bpred_2bitsat_update(void *state, md_addr_t PC, bool resolveDir, bool predDir, md_addr_t branchTarget);
+void *bpred_2level_init(void);
+bool bpred_2level_get(void *state, md_addr_t PC);
+void bpred_2level_update(void *state, md_addr_t PC, bool resolveDir, bool predDir, md_addr_t branchTarget);
+
+static const tom_bpred_t tom_bpreds[] = {
+    {"perfect", bpred_static_init, NULL, bpred_static_update},
+    {"taken", bpred_static_init, bpred_taken_get, bpred_static_update},
+    {"nottaken", bpred_static_init, bpred_nottaken_get, bpred_static_update},
+    {"2bitsat", bpred_2bitsat_init, bpred_2bitsat_get, bpred_2bitsat_update},
+    {"2level", bpred_2level_init, bpred_2level_get, bpred_2level_update},
+};
 
-// reservation stations (each reservation station entry contains a pointer to an instruction)
-static instruction_t *reservINT[RESERV_INT_SIZE];
-static instruction_t *reservFP[RESERV_FP_SIZE];
+#define TOM_NUM_BPREDS (int)(sizeof(tom_bpreds) / sizeof(tom_bpreds[0]))
 
-// functional units
-static instruction_t *fuINT[FU_INT_SIZE];
-static instruction_t *fuFP[FU_FP_SIZE];
+/* EVENT-DRIVEN SCHEDULER */
+/*
+ * Instead of rescanning every RS entry and FU each cycle, every stage
+ * only touches the entries an event names:
+ *
+ *   wakeup     a consumer registers one node per source operand on the RS
+ *              entry of its producer (waiters). The CDB broadcast walks
+ *              that list and decrements pending of each consumer.
+ *   wake queue entries whose last operand arrived or that were issued,
+ *              with the first cycle they may execute (one cycle later, as
+ *              a value on the CDB is only read the next cycle). FIFO,
+ *              the cycles are appended in order.
+ *   ready      per fu_type, a min-heap by program order of the entries
+ *              that may execute, so select is oldest first.
+ *   wheel      FU completions, bucket cycle % wheel_size, one bucket
+ *              more than the longest FU latency.
+ *   completed  min-heap by program order of the finished instructions
+ *              waiting for the CDB.
+ *
+ * With a reorder buffer a conditional branch has to execute to resolve.
+ * It takes one of cfg.rob_size branch slots after the INT and FP ones
+ * instead of an integer RS entry, and once its operands are ready goes
+ * straight into the wheel for -tom:lat_br cycles, without a FU or a
+ * place in the issue width, as a branch unit next to the ALUs would.
+ *
+ * The cycles recorded for each instruction are the same as with the
+ * scanning stages.
+ */
 
-// common data bus
-static instruction_t *commonDataBus = NULL;
+typedef struct
+{
+  int pending;    // source operands whose producer has not written the CDB
+  bool issued;    // went through dispatch_To_issue
+  int waiters;    // first wakeup node of the consumers of this entry, -1 if none
+  int wheel_next; // next entry completing in the same wheel bucket, -1 if none
+  int rob;        // reorder buffer entry of the instruction
+  int lsq;        // load or store queue entry of a memory instruction
+} rs_sched_t;
+
+typedef struct
+{
+  instruction_t *instr;
+  counter_t done_cycle; // cycle the result was written, 0 while in flight
+  int slot;             // RS slot taken at dispatch, -1 for branches without one
+} rob_entry_t;
 
-// The map table keeps track of which instruction produces the value for each register
-static instruction_t *map_table[MD_TOTAL_REGS];
+/* LOAD/STORE QUEUE */
+/*
+ * With -tom:lq and -tom:sq every load and store takes an entry of the
+ * load or store queue at dispatch, in program order, and frees it when it
+ * commits. Addresses come from the trace (mem_addr); two accesses alias
+ * when they fall in the same doubleword. A store knows its address and
+ * data once it finishes executing, and is visible to loads the cycle
+ * after. A load about to execute looks at the older stores:
+ *
+ *   forward    the youngest older known store to the same doubleword
+ *              hands over its data in -tom:lat_fwd cycles instead of the
+ *              -tom:lat_int of a memory access.
+ *   blocked    without -tom:spec_loads an older store with an unknown
+ *              address blocks the load, which gives back its FU and waits
+ *              for the next store to finish.
+ *   violation  with -tom:spec_loads unknown addresses are assumed not to
+ *              alias. A store that finishes and finds a younger executed
+ *              load to its doubleword that did not forward from a store
+ *              younger than itself has caught a memory-order violation.
+ *              A load that has not written the CDB yet replays: it gives
+ *              back its FU and executes again. One that has handed the
+ *              stale value to its consumers: at the end of the execute
+ *              stage the load and everything younger is squashed from the
+ *              RS, FUs, ROB and queues, and fetched again from the load
+ *              after the redirect penalty (tom_num_squashed).
+ */
+typedef struct
+{
+  instruction_t *instr;
+  int slot;             // RS slot of the instruction, valid until it writes the CDB
+  counter_t done_cycle; // stores: cycle the address and data were known, 0 until then
+  bool issued;          // loads: executing or executed with the current value
+  bool forwarded;       // loads: the value came from the store with index fwd_index
+  int fwd_index;
+  bool blocked;   // loads: waiting for an older store address
+  bool replay;    // loads: executing with a stale value, executes again when done
+  bool broadcast; // loads: wrote the CDB
+} lsq_entry_t;
+
+// ring of queue entries in program order
+typedef struct
+{
+  lsq_entry_t *entry;
+  int size;
+  int head;
+  int count;
+} lsq_t;
 
-// the index of the last instruction fetched
-static int fetch_index = 0;
+enum load_check
+{
+  LOAD_ISSUE,
+  LOAD_BLOCKED,
+  LOAD_RETRY // a store address arrived this cycle, look again the next
+};
 
-/* FUNCTIONAL UNITS */
+// min-heap (or stack for the free lists) of RS slots
+typedef struct
+{
+  int *slot;
+  int size;
+} slot_heap_t;
 
-/* RESERVATION STATIONS */
+/* STREAMING */
+/*
+ * With -tom:stream the simulator does not build an instruction_trace_t.
+ * It hands every instruction to the engine as it is executed:
+ *
+ *   tomasulo_stream_begin(retire);
+ *   for each instruction
+ *     instr = tomasulo_stream_alloc();   fill inst, index, pc, op, r_in, r_out, mem_addr
+ *     tomasulo_stream_push(instr);
+ *   cycles = tomasulo_stream_finish();
+ *
+ * index must count up in program order (it may wrap). mem_addr is read
+ * for loads and stores by the load/store queue. Push simulates cycles as
+ * long as the window of pushed but not fetched instructions holds more
+ * than a fetch group, so the next PC of every fetched branch is known. Records come from a pool: one is recycled once it has retired
+ * (left the ROB, or the machine without one) and no in-flight consumer
+ * points at it through Q, after retire was called with its cycles. The
+ * pool only grows with the instructions in flight, not with the length
+ * of the run. Traps are recycled at push, as fetch skips them.
+ */
+typedef struct tom_record
+{
+  instruction_t instr; // first, so records are handed out as instruction_t *
+  md_addr_t next_pc;   // from the window at fetch, to fetch it again after a squash
+  int refs;            // Q pointers of consumers that have not executed
+  bool retired;
+  struct tom_record *next_free;
+} tom_record_t;
+
+typedef struct
+{
+  instruction_t *instr;
+  md_addr_t next_pc; // pc of the next instruction pushed, for branch outcomes
+} tom_window_entry_t;
+
+typedef struct
+{
+  // ring of pushed instructions fetch has not taken yet
+  tom_window_entry_t *window;
+  int capacity;
+  int head;
+  int count;
+  int last; // entry whose next_pc comes with the next push, -1 if none
+  bool done;
+
+  tom_record_t *free_list;
+  counter_t num_records; // allocated by the pool
+  void (*retire)(instruction_t *instr);
+} tom_stream_t;
+
+/* MACHINE STATE */
+/*
+ * Everything one simulation touches lives in a tomasulo_t sized from its
+ * configuration, so the runs of a sweep share the read-only trace and
+ * nothing else. Only the run with record set writes the tom_*_cycle and
+ * Q fields of the instructions; the others read op, r_in, r_out and
+ * index only.
+ */
+typedef struct
+{
+  tomasulo_config_t cfg;
+  bool record;
+
+  // instruction queue for tomasulo, a ring of cfg.ifq_size entries in program order
+  instruction_t **instr_queue;
+  // position of the oldest instruction in the instruction queue
+  int instr_queue_head;
+  // number of instructions in the instruction queue
+  int instr_queue_size;
+
+  // reservation stations (each reservation station entry contains a pointer to an instruction)
+  // INT entries come first, the slot number of an entry indexes the scheduler state below
+  instruction_t **reserv;
+  int rs_total;
+
+  // functional units in use per fu_type, a unit is held from execute until the CDB
+  int fu_busy[2];
+
+  // common data buses, the first cdb_used carry a result this cycle
+  instruction_t **commonDataBus;
+  int cdb_used;
+
+  // The map table keeps track of which instruction produces the value for each register
+  instruction_t *map_table[MD_TOTAL_REGS];
+  // RS slot of the producer of each register, -1 once it has written the CDB
+  int map_slot[MD_TOTAL_REGS];
+
+  // the index of the last instruction fetched
+  int fetch_index;
+
+  rs_sched_t *rs_sched;
+  // node 3 * slot + j is operand j of the consumer in slot
+  int *wakeup_next;
+
+  // free slots per fu_type, BR only with a reorder buffer
+  slot_heap_t rs_free[3];
+  slot_heap_t ready[2];
+  slot_heap_t completed;
+
+  int *wake_queue;
+  counter_t *wake_cycle;
+  int wake_head;
+  int wake_count;
+
+  // entries that entered an RS this cycle, issued the next one
+  int *dispatched;
+  int dispatched_count;
+
+  int *wheel;
+  int wheel_size;
+
+  // reorder buffer, a ring of cfg.rob_size entries in program order
+  rob_entry_t *rob;
+  int rob_head;
+  int rob_count;
+
+  // load and store queues, used when cfg.lq_size > 0
+  lsq_t lq;
+  lsq_t sq;
+  counter_t num_load_forwards;
+  counter_t num_mem_violations;
+  // oldest load that wrote the CDB with a stale value this cycle, NULL if none
+  instruction_t *squash_from;
+  counter_t num_squashed;
+
+  const tom_bpred_t *bpred;
+  void *bpred_state;
+  // mispredicted branch fetch waits for, and the first cycle fetch may resume after it resolved
+  instruction_t *fetch_block;
+  counter_t fetch_resume;
+  counter_t num_cond_branches;
+  counter_t num_mispred;
+
+  // NULL: instructions come from the trace
+  tom_stream_t *stream;
+  counter_t cycle;
+} tomasulo_t;
+
+// machine of the -tom:stream run
+static tomasulo_t *tom_stream_machine = NULL;
 
-/* ECE552 Assignment 3 - BEGIN CODE */
 // helper functions
-int get_free_rs_entry(instruction_t **rs, int size);
-void update_map_table(instruction_t *instr, instruction_t **map_table);
-void remove_instr_from_ifq(instruction_t **instr_queue, int *instr_queue_size);
-void issue_rdy_instr(instruction_t **rs, int rs_size, int current_cycle);
-bool instr_dispatched(instruction_t *instr, int current_cycle);
-bool instr_issued(instruction_t *instr, int current_cycle);
-bool instr_ready_to_execute(instruction_t *instr, int current_cycle);
-bool instr_executed(instruction_t *instr, int current_cycle, int latency);
-void sort_instr(instruction_t **instr_array, int instr_count);
-void allocate_fu(instruction_t **ready_instr, int ready_count, instruction_t **fu, int fu_size, int current_cycle);
-void free_entry(instruction_t **rs, int rs_size, instruction_t *instr);
+void *tom_alloc(size_t count, size_t size);
+tomasulo_t *tomasulo_create(const tomasulo_config_t *cfg, bool record);
+void tomasulo_free(tomasulo_t *m);
+counter_t tomasulo_run(tomasulo_t *m, instruction_trace_t *trace);
+void tomasulo_cycle(tomasulo_t *m, instruction_trace_t *trace);
+bool older(instruction_t *a, instruction_t *b);
+void retire_instr(tomasulo_t *m, instruction_t *instr);
+void unref_instr(tomasulo_t *m, instruction_t *instr);
+void recycle_record(tom_stream_t *stream, tom_record_t *rec);
+void tomasulo_sweep(instruction_trace_t *trace);
+int *tom_param(tomasulo_config_t *cfg, int param);
+const tom_bpred_t *find_bpred(const char *name);
+const char *config_error(const tomasulo_config_t *cfg);
+bool branch_taken(instruction_trace_t *trace, instruction_t *instr);
+int rob_push(tomasulo_t *m, instruction_t *instr);
+void complete_instr(tomasulo_t *m, int slot, counter_t cycle);
+int lsq_push(lsq_t *q, instruction_t *instr, int slot);
+enum load_check disambiguate_load(tomasulo_t *m, lsq_entry_t *load, counter_t cycle);
+void store_done(tomasulo_t *m, lsq_entry_t *store, counter_t cycle);
+void replay_load(tomasulo_t *m, int slot, counter_t cycle);
+enum fu_type slot_fu_type(tomasulo_t *m, int slot);
+void start_execute(tomasulo_t *m, int slot, int latency, counter_t cycle);
+bool slot_squashed(tomasulo_t *m, int slot, instruction_t *first);
+void heap_squash(tomasulo_t *m, slot_heap_t *heap, instruction_t *first, bool holds_fu);
+void squash_from(tomasulo_t *m, instruction_t *first, counter_t cycle);
+void refetch_instr(tomasulo_t *m, instruction_t *instr);
+void heap_push(tomasulo_t *m, slot_heap_t *heap, int slot);
+int heap_pop(tomasulo_t *m, slot_heap_t *heap);
+void wake_push(tomasulo_t *m, int slot, counter_t cycle);
+int alloc_rs_entry(tomasulo_t *m, enum fu_type type);
+void release_rs_entry(tomasulo_t *m, int slot);
+void update_map_table(tomasulo_t *m, instruction_t *instr, int slot);
+void remove_instr_from_ifq(tomasulo_t *m);
+/* ECE552 Assignment 3 - END CODE */
 
-enum fu_type
+/*
+ * Description:
+ * 	Registers the machine parameters as simulator options,
+ *      called from the simulator's sim_reg_options
+ * Inputs:
+ * 	odb: the option database
+ * Returns:
+ * 	None
+ */
+void tomasulo_reg_options(struct opt_odb_t *odb)
 {
-  INT,
-  FP
-};
-/* ECE552 Assignment 3 - END CODE */
+  opt_reg_int(odb, "-tom:ifq", "instruction fetch queue entries",
+              &tom_config.ifq_size, /* default */ INSTR_QUEUE_SIZE,
+              /* print */ TRUE, /* format */ NULL);
+  opt_reg_int(odb, "-tom:rs_int", "integer reservation stations",
+              &tom_config.rs_size[INT], /* default */ RESERV_INT_SIZE,
+              /* print */ TRUE, /* format */ NULL);
+  opt_reg_int(odb, "-tom:rs_fp", "floating-point reservation stations",
+              &tom_config.rs_size[FP], /* default */ RESERV_FP_SIZE,
+              /* print */ TRUE, /* format */ NULL);
+  opt_reg_int(odb, "-tom:fu_int", "integer functional units",
+              &tom_config.fu_size[INT], /* default */ FU_INT_SIZE,
+              /* print */ TRUE, /* format */ NULL);
+  opt_reg_int(odb, "-tom:fu_fp", "floating-point functional units",
+              &tom_config.fu_size[FP], /* default */ FU_FP_SIZE,
+              /* print */ TRUE, /* format */ NULL);
+  opt_reg_int(odb, "-tom:lat_int", "integer functional unit latency",
+              &tom_config.fu_latency[INT], /* default */ FU_INT_LATENCY,
+              /* print */ TRUE, /* format */ NULL);
+  opt_reg_int(odb, "-tom:lat_fp", "floating-point functional unit latency",
+              &tom_config.fu_latency[FP], /* default */ FU_FP_LATENCY,
+              /* print */ TRUE, /* format */ NULL);
+  opt_reg_int(odb, "-tom:fetch_width", "instructions fetched into the IFQ per cycle",
+              &tom_config.fetch_width, /* default */ FETCH_WIDTH,
+              /* print */ TRUE, /* format */ NULL);
+  opt_reg_int(odb, "-tom:dispatch_width", "instructions dispatched from the IFQ per cycle",
+              &tom_config.dispatch_width, /* default */ DISPATCH_WIDTH,
+              /* print */ TRUE, /* format */ NULL);
+  opt_reg_int(odb, "-tom:issue_width", "instructions sent to the FUs per cycle (0 = no limit)",
+              &tom_config.issue_width, /* default */ ISSUE_WIDTH,
+              /* print */ TRUE, /* format */ NULL);
+  opt_reg_int(odb, "-tom:cdbs", "common data buses (writeback width)",
+              &tom_config.num_cdbs, /* default */ NUM_CDBS,
+              /* print */ TRUE, /* format */ NULL);
+  opt_reg_int(odb, "-tom:rob", "reorder buffer entries (0 = no reorder buffer), "
+              "conditional branches then resolve in a branch unit in -tom:lat_br cycles",
+              &tom_config.rob_size, /* default */ ROB_SIZE,
+              /* print */ TRUE, /* format */ NULL);
+  opt_reg_int(odb, "-tom:commit_width", "instructions committed per cycle",
+              &tom_config.commit_width, /* default */ COMMIT_WIDTH,
+              /* print */ TRUE, /* format */ NULL);
+  opt_reg_int(odb, "-tom:redirect_penalty", "cycles from resolving a mispredicted branch to fetching again",
+              &tom_config.redirect_penalty, /* default */ REDIRECT_PENALTY,
+              /* print */ TRUE, /* format */ NULL);
+  opt_reg_int(odb, "-tom:lat_br", "conditional branch resolution latency, with a reorder buffer",
+              &tom_config.br_latency, /* default */ BRANCH_LATENCY,
+              /* print */ TRUE, /* format */ NULL);
+  opt_reg_int(odb, "-tom:lq", "load queue entries (0 = no load/store queue)",
+              &tom_config.lq_size, /* default */ LQ_SIZE,
+              /* print */ TRUE, /* format */ NULL);
+  opt_reg_int(odb, "-tom:sq", "store queue entries (0 = no load/store queue)",
+              &tom_config.sq_size, /* default */ SQ_SIZE,
+              /* print */ TRUE, /* format */ NULL);
+  opt_reg_int(odb, "-tom:spec_loads", "loads issue past stores with unknown addresses, replaying on a violation",
+              &tom_config.spec_loads, /* default */ SPEC_LOADS,
+              /* print */ TRUE, /* format */ NULL);
+  opt_reg_int(odb, "-tom:lat_fwd", "latency of a load forwarded from the store queue",
+              &tom_config.fwd_latency, /* default */ FORWARD_LATENCY,
+              /* print */ TRUE, /* format */ NULL);
+  opt_reg_string(odb, "-tom:bpred", "direction predictor steering fetch (perfect, taken, nottaken, 2bitsat, 2level)",
+                 &tom_config.bpred, /* default */ BPRED,
+                 /* print */ TRUE, /* format */ NULL);
+  opt_reg_flag(odb, "-tom:stream", "simulate instructions as they are executed, in constant memory",
+               &tom_stream, /* default */ FALSE,
+               /* print */ TRUE, /* format */ NULL);
+  opt_reg_string(odb, "-tom:sweep",
+                 "also run every configuration of <param>=<lo>[:<hi>[:<step>]],... "
+                 "over the trace, <param> is any -tom:* machine parameter without -tom:",
+                 &tom_sweep, /* default */ NULL,
+                 /* print */ TRUE, /* format */ NULL);
+  opt_reg_int(odb, "-tom:threads", "sweep worker threads (0 = one per online cpu)",
+              &tom_threads, /* default */ 0,
+              /* print */ TRUE, /* format */ NULL);
+}
+
+/*
+ * Description:
+ * 	Checks the machine parameters, called from the simulator's sim_check_options
+ * Inputs:
+ * 	None
+ * Returns:
+ * 	None
+ */
+void tomasulo_check_options(void)
+{
+  for (int p = 0; p < TOM_NUM_PARAMS; p++)
+  {
+    int value = *tom_param(&tom_config, p);
+    if (value < tom_param_min[p] || value > TOM_PARAM_MAX)
+    {
+      fatal("-tom:%s must be between %d and %d", tom_param_name[p], tom_param_min[p], TOM_PARAM_MAX);
+    }
+  }
+  if (tom_threads < 0)
+  {
+    fatal("-tom:threads must be >= 0");
+  }
+  if (tom_stream && tom_sweep != NULL && tom_sweep[0] != '\0')
+  {
+    fatal("-tom:sweep needs the whole trace, it cannot be used with -tom:stream");
+  }
+  const char *error = config_error(&tom_config);
+  if (error != NULL)
+  {
+    fatal("%s", error);
+  }
+}
+
+/*
+ * Description:
+ * 	Registers the statistics of the -tom:* run, called from the simulator's sim_reg_stats
+ * Inputs:
+ * 	sdb: the stats database
+ * Returns:
+ * 	None
+ */
+void tomasulo_reg_stats(struct stat_sdb_t *sdb)
+{
+  stat_reg_counter(sdb, "tom_num_cond_branches",
+                   "conditional branches fetched by the Tomasulo engine",
+                   &tom_num_cond_branches, 0, NULL);
+  stat_reg_counter(sdb, "tom_num_mispred",
+                   "conditional branches mispredicted by -tom:bpred",
+                   &tom_num_mispred, 0, NULL);
+  stat_reg_formula(sdb, "tom_mispred_rate",
+                   "fraction of conditional branches mispredicted",
+                   "tom_num_mispred / tom_num_cond_branches", NULL);
+  stat_reg_counter(sdb, "tom_num_load_forwards",
+                   "load executions served by the store queue",
+                   &tom_num_load_forwards, 0, NULL);
+  stat_reg_counter(sdb, "tom_num_mem_violations",
+                   "loads that executed before an older store to the same address",
+                   &tom_num_mem_violations, 0, NULL);
+  stat_reg_counter(sdb, "tom_num_squashed",
+                   "instructions squashed and fetched again after a violating load wrote the CDB",
+                   &tom_num_squashed, 0, NULL);
+}
 
 /*
  * Description:
  * 	Checks if simulation is done by finishing the very last instruction
  *      Remember that simulation is done only if the entire pipeline is empty
  * Inputs:
+ * 	m: the machine being simulated
  * 	sim_insn: the total number of instructions simulated
  * Returns:
  * 	True: if simulation is finished
  */
-static bool is_simulation_done(counter_t sim_insn)
+static bool is_simulation_done(tomasulo_t *m, counter_t sim_insn)
 {
 
   /* ECE552: YOUR CODE GOES HERE */
   /*
     simulation is done if all instructions have been feteched
-    and if the IFQ, CBD, RS, and FU are empty
+    and if the IFQ, CBD, RS, FU and ROB are empty
   */
-  if (sim_insn > fetch_index)
+  if (m->stream != NULL ? !m->stream->done || m->stream->count > 0 : sim_insn > m->fetch_index)
   {
     return false;
   }
-  if (instr_queue_size > 0)
+  if (m->instr_queue_size > 0)
   {
     return false;
   }
-  if (commonDataBus != NULL)
+  if (m->cdb_used > 0)
   {
     return false;
   }
-  for (int i = 0; i < RESERV_INT_SIZE; i++)
+  if (m->rs_free[INT].size < m->cfg.rs_size[INT] || m->rs_free[FP].size < m->cfg.rs_size[FP])
   {
-    if (reservINT[i] != NULL)
-    {
-      return false;
-    }
+    return false;
   }
-  for (int i = 0; i < RESERV_FP_SIZE; i++)
+  if (m->fu_busy[INT] > 0 || m->fu_busy[FP] > 0)
   {
-    if (reservFP[i] != NULL)
-    {
-      return false;
-    }
+    return false;
   }
-  for (int i = 0; i < FU_INT_SIZE; i++)
+  if (m->rob_count > 0)
   {
-    if (fuINT[i] != NULL)
-    {
-      return false;
-    }
+    return false;
   }
-  for (int i = 0; i < FU_FP_SIZE; i++)
+  return true;
+}
+
+/*
+ * Description:
+ * 	Commits finished instructions from the head of the reorder buffer in program order,
+ *      an instruction commits the cycle after its result was written at the earliest
+ * Inputs:
+ * 	m: the machine being simulated
+ * 	current_cycle: the cycle we are at
+ * Returns:
+ * 	None
+ */
+void ROB_To_commit(tomasulo_t *m, counter_t current_cycle)
+{
+  for (int i = 0; i < m->cfg.commit_width && m->rob_count > 0; i++)
   {
-    if (fuFP[i] != NULL)
+    rob_entry_t *head = &m->rob[m->rob_head];
+    if (head->done_cycle == 0 || head->done_cycle >= current_cycle)
+    {
+      return;
+    }
+    // memory instructions leave their queue in program order
+    if (m->cfg.lq_size > 0 && (IS_LOAD(head->instr->op) || IS_STORE(head->instr->op)))
     {
-      return false;
+      lsq_t *q = IS_LOAD(head->instr->op) ? &m->lq : &m->sq;
+      q->entry[q->head].instr = NULL;
+      q->head = (q->head + 1) % q->size;
+      q->count--;
     }
+    retire_instr(m, head->instr);
+    head->instr = NULL;
+    head->done_cycle = 0;
+    m->rob_head = (m->rob_head + 1) % m->cfg.rob_size;
+    m->rob_count--;
   }
-  return true;
 }
 
 /*
  * Description:
  * 	Retires the instruction from writing to the Common Data Bus
  * Inputs:
+ * 	m: the machine being simulated
  * 	current_cycle: the cycle we are at
  * Returns:
  * 	None
  */
-void CDB_To_retire(int current_cycle)
+void CDB_To_retire(tomasulo_t *m, counter_t current_cycle)
 {
 
   /* ECE552: YOUR CODE GOES HERE */
-  if (commonDataBus == NULL)
+  // clear the CDBs, the instructions leave the machine without a reorder buffer
+  for (int i = 0; i < m->cdb_used; i++)
   {
-    return;
+    if (m->cfg.rob_size == 0)
+    {
+      retire_instr(m, m->commonDataBus[i]);
+    }
+    m->commonDataBus[i] = NULL;
   }
-  // clear the CDB
-  commonDataBus = NULL;
+  m->cdb_used = 0;
 }
 
 /*
  * Description:
- * 	Moves an instruction from the execution stage to common data bus (if possible)
+ * 	Moves instructions from the execution stage to the common data buses (if possible)
  * Inputs:
+ * 	m: the machine being simulated
  * 	current_cycle: the cycle we are at
  * Returns:
  * 	None
  */
-void execute_To_CDB(int current_cycle)
+void execute_To_CDB(tomasulo_t *m, counter_t current_cycle)
 {
 
   /* ECE552: YOUR CODE GOES HERE */
-  // find instructions that finish executing this cycle
-  instruction_t *completing_int[FU_INT_SIZE];
-  instruction_t *completing_fp[FU_FP_SIZE];
-  int completing_int_count = 0;
-  int completing_fp_count = 0;
-
-  // check int fu
-  for (int i = 0; i < FU_INT_SIZE; i++)
+  // instructions that finish executing this cycle
+  int bucket = current_cycle % m->wheel_size;
+  int slot = m->wheel[bucket];
+  m->wheel[bucket] = -1;
+  while (slot != -1)
   {
-    if (fuINT[i] != NULL)
+    int next = m->rs_sched[slot].wheel_next;
+    instruction_t *instr = m->reserv[slot];
+    // if store instr, or a branch resolving
+    if (IS_STORE(instr->op) || IS_COND_CTRL(instr->op))
     {
-      instruction_t *instr = fuINT[i];
-      if (instr_executed(instr, current_cycle, FU_INT_LATENCY))
+      // don't braodcast on cbd, free fu and rs entry
+      if (m->record)
       {
-        // if store instr,
-        if (IS_STORE(instr->op))
-        {
-          // don't braodcast on cbd
-          instr->tom_cdb_cycle = 0;
-          // free rs entry
-          free_entry(reservINT, RESERV_INT_SIZE, instr);
-          // free fu entry
-          fuINT[i] = NULL;
-        }
-        else
-        {
-          // add to list of instr that need to be broadcast
-          completing_int[completing_int_count++] = instr;
-        }
+        instr->tom_cdb_cycle = 0;
       }
-    }
-  }
-
-  // check fp fu
-  for (int i = 0; i < FU_FP_SIZE; i++)
-  {
-    if (fuFP[i] != NULL)
-    {
-      instruction_t *instr = fuFP[i];
-      if (instr_executed(instr, current_cycle, FU_FP_LATENCY))
+      if (m->cfg.lq_size > 0 && IS_STORE(instr->op))
+      {
+        store_done(m, &m->sq.entry[m->rs_sched[slot].lsq], current_cycle);
+      }
+      complete_instr(m, slot, current_cycle);
+      if (slot_fu_type(m, slot) != BR)
+      {
+        m->fu_busy[slot_fu_type(m, slot)]--;
+      }
+      release_rs_entry(m, slot);
+      if (m->cfg.rob_size == 0)
       {
-        completing_fp[completing_fp_count++] = instr;
+        retire_instr(m, instr);
       }
     }
+    else if (m->cfg.lq_size > 0 && IS_LOAD(instr->op) && m->lq.entry[m->rs_sched[slot].lsq].replay)
+    {
+      replay_load(m, slot, current_cycle);
+    }
+    else
+    {
+      // wait for the CDB
+      heap_push(m, &m->completed, slot);
+    }
+    slot = next;
   }
 
-  // find oldest instr and its index in the FU
-  instruction_t *oldest_instr = NULL;
-  int fu_index = -1;
-  enum fu_type fu_type = 0;
+  // a store caught a load that already wrote the CDB
+  if (m->squash_from != NULL)
+  {
+    squash_from(m, m->squash_from, current_cycle);
+    m->squash_from = NULL;
+  }
 
-  // find the oldest completed instr
-  for (int i = 0; i < completing_int_count; i++)
+  // boardcast the oldest completed instrs on the free CDBs
+  while (m->cdb_used < m->cfg.num_cdbs && m->completed.size > 0)
   {
-    if (oldest_instr == NULL || completing_int[i]->index < oldest_instr->index)
+    slot = heap_pop(m, &m->completed);
+    instruction_t *instr = m->reserv[slot];
+    // a store that finished this cycle may have caught the load
+    if (m->cfg.lq_size > 0 && IS_LOAD(instr->op))
     {
-      oldest_instr = completing_int[i];
-      fu_type = INT;
-      for (int j = 0; j < FU_INT_SIZE; j++)
+      lsq_entry_t *load = &m->lq.entry[m->rs_sched[slot].lsq];
+      if (load->replay)
       {
-        if (fuINT[j] == oldest_instr)
-        {
-          fu_index = j;
-          break;
-        }
+        replay_load(m, slot, current_cycle);
+        continue;
       }
+      load->broadcast = true;
+    }
+    m->commonDataBus[m->cdb_used++] = instr;
+    if (m->record)
+    {
+      instr->tom_cdb_cycle = current_cycle;
     }
-  }
 
-  for (int i = 0; i < completing_fp_count; i++)
-  {
-    if (oldest_instr == NULL || completing_fp[i]->index < oldest_instr->index)
+    // later consumers of the registers it writes read the register file
+    for (int i = 0; i < 2; i++)
     {
-      oldest_instr = completing_fp[i];
-      fu_type = FP;
-      for (int j = 0; j < FU_FP_SIZE; j++)
+      if (instr->r_out[i] != DNA && instr->r_out[i] != 0 && m->map_slot[instr->r_out[i]] == slot)
       {
-        if (fuFP[j] == oldest_instr)
-        {
-          fu_index = j;
-          break;
-        }
+        m->map_slot[instr->r_out[i]] = -1;
       }
     }
-  }
 
-  // boardcast if instr availble and CBD free
-  if (commonDataBus == NULL && oldest_instr != NULL)
-  {
-    commonDataBus = oldest_instr;
-    oldest_instr->tom_cdb_cycle = current_cycle;
-    // if oldest instr is an int, free int rs and fu
-    if (fu_type == INT)
-    {
-      free_entry(reservINT, RESERV_INT_SIZE, oldest_instr);
-      fuINT[fu_index] = NULL;
-    }
-    // if oldest instr is an fp, free fp rs and fu
-    else if (fu_type == FP)
+    complete_instr(m, slot, current_cycle);
+
+    // wake up the consumers waiting on this entry
+    for (int node = m->rs_sched[slot].waiters; node != -1; node = m->wakeup_next[node])
     {
-      free_entry(reservFP, RESERV_FP_SIZE, oldest_instr);
-      fuFP[fu_index] = NULL;
+      int consumer = node / 3;
+      m->rs_sched[consumer].pending--;
+      if (m->rs_sched[consumer].pending == 0 && m->rs_sched[consumer].issued)
+      {
+        wake_push(m, consumer, current_cycle + 1);
+      }
     }
+
+    // free fu and rs entry
+    m->fu_busy[slot_fu_type(m, slot)]--;
+    release_rs_entry(m, slot);
   }
 }
 
@@ -327,211 +884,314 @@ void execute_To_CDB(int current_cycle)
  *      (in program order) over new ones, if they both contend for the same functional unit.
  *      All RAW dependences need to have been resolved with stalls before an instruction enters execute.
  * Inputs:
+ * 	m: the machine being simulated
  * 	current_cycle: the cycle we are at
  * Returns:
  * 	None
  */
-void issue_To_execute(int current_cycle)
+void issue_To_execute(tomasulo_t *m, counter_t current_cycle)
 {
 
   /* ECE552: YOUR CODE GOES HERE */
-  instruction_t *ready_int[RESERV_INT_SIZE];
-  instruction_t *ready_fp[RESERV_FP_SIZE];
-  int ready_int_count = 0;
-  int ready_fp_count = 0;
-
-  // find all integer instructions ready to execute
-  for (int i = 0; i < RESERV_INT_SIZE; i++)
+  // entries that became ready before this cycle
+  while (m->wake_count > 0 && m->wake_cycle[m->wake_head] <= current_cycle)
   {
-    if (reservINT[i] != NULL)
+    int slot = m->wake_queue[m->wake_head];
+    // branches do not compete for the FUs
+    if (slot_fu_type(m, slot) == BR)
     {
-      instruction_t *instr = reservINT[i];
-      // check if instruction is in issue stage and RAW dependencies are resolved
-      if (instr_ready_to_execute(instr, current_cycle))
-      {
-        ready_int[ready_int_count++] = instr;
-      }
+      start_execute(m, slot, m->cfg.br_latency, current_cycle);
+    }
+    else
+    {
+      heap_push(m, &m->ready[slot_fu_type(m, slot)], slot);
     }
+    m->wake_head = (m->wake_head + 1) % m->rs_total;
+    m->wake_count--;
   }
 
-  // find all FP instructions ready to execute
-  for (int i = 0; i < RESERV_FP_SIZE; i++)
+  // allocate free fus to the oldest ready instructions, up to the issue width
+  int issued = 0;
+  while (m->cfg.issue_width == 0 || issued < m->cfg.issue_width)
   {
-    if (reservFP[i] != NULL)
+    // oldest ready instruction of a type with a free fu
+    int type = -1;
+    for (int t = INT; t <= FP; t++)
     {
-      instruction_t *instr = reservFP[i];
-      // check if instruction is in issue stage and RAW dependencies are resolved
-      if (instr_ready_to_execute(instr, current_cycle))
+      if (m->fu_busy[t] < m->cfg.fu_size[t] && m->ready[t].size > 0 &&
+          (type == -1 || older(m->reserv[m->ready[t].slot[0]], m->reserv[m->ready[type].slot[0]])))
       {
-        ready_fp[ready_fp_count++] = instr;
+        type = t;
       }
     }
-  }
+    if (type == -1)
+    {
+      break;
+    }
 
-  // sort ready integer instructions
-  sort_instr(ready_int, ready_int_count);
-  // sort ready FU intstructions
-  sort_instr(ready_fp, ready_fp_count);
+    int slot = heap_pop(m, &m->ready[type]);
+    instruction_t *instr = m->reserv[slot];
+    int latency = m->cfg.fu_latency[type];
 
-  // allocate int fu entry
-  allocate_fu(ready_int, ready_int_count, fuINT, FU_INT_SIZE, current_cycle);
-  // allocate fp fu entry
-  allocate_fu(ready_fp, ready_fp_count, fuFP, FU_FP_SIZE, current_cycle);
+    // loads check the older stores first
+    if (m->cfg.lq_size > 0 && IS_LOAD(instr->op))
+    {
+      lsq_entry_t *load = &m->lq.entry[m->rs_sched[slot].lsq];
+      enum load_check check = disambiguate_load(m, load, current_cycle);
+      if (check == LOAD_BLOCKED)
+      {
+        load->blocked = true;
+        continue;
+      }
+      if (check == LOAD_RETRY)
+      {
+        wake_push(m, slot, current_cycle + 1);
+        continue;
+      }
+      load->issued = true;
+      if (load->forwarded)
+      {
+        latency = m->cfg.fwd_latency;
+        m->num_load_forwards++;
+      }
+    }
+    m->fu_busy[type]++;
+    start_execute(m, slot, latency, current_cycle);
+    issued++;
+  }
 }
 
 /*
  * Description:
  * 	Moves instruction(s) from the dispatch stage to the issue stage
  * Inputs:
+ * 	m: the machine being simulated
  * 	current_cycle: the cycle we are at
  * Returns:
  * 	None
  */
-void dispatch_To_issue(int current_cycle)
+void dispatch_To_issue(tomasulo_t *m, counter_t current_cycle)
 {
 
   /* ECE552: YOUR CODE GOES HERE */
-  // check all int reservation stations
-  for (int entry = 0; entry < RESERV_INT_SIZE; entry++)
+  // only the entries that entered an RS last cycle
+  for (int i = 0; i < m->dispatched_count; i++)
   {
-    if (reservINT[entry] != NULL)
+    int slot = m->dispatched[i];
+    if (m->record)
     {
-      instruction_t *instr = reservINT[entry];
-
-      if (instr_dispatched(instr, current_cycle))
-      {
-        instr->tom_issue_cycle = current_cycle;
-      }
+      m->reserv[slot]->tom_issue_cycle = current_cycle;
     }
-  }
-
-  // check all fp reservation stations
-  for (int entry = 0; entry < RESERV_FP_SIZE; entry++)
-  {
-    if (reservFP[entry] != NULL)
+    m->rs_sched[slot].issued = true;
+    if (m->rs_sched[slot].pending == 0)
     {
-      instruction_t *instr = reservFP[entry];
-
-      if (instr_dispatched(instr, current_cycle))
-      {
-        instr->tom_issue_cycle = current_cycle;
-      }
+      wake_push(m, slot, current_cycle + 1);
     }
   }
+  m->dispatched_count = 0;
 }
 
 /*
  * Description:
- * 	Grabs an instruction from the instruction trace (if possible)
+ * 	Grabs an instruction from the instruction trace (if possible),
+ *      predicting conditional branches. After a misprediction nothing is
+ *      fetched until the branch resolved and the redirect penalty passed;
+ *      the trace has no wrong-path instructions, so this stall stands in
+ *      for fetching and squashing them.
  * Inputs:
+ * 	m: the machine being simulated
  *      trace: instruction trace with all the instructions executed
+ * 	current_cycle: the cycle we are at
  * Returns:
  * 	None
  */
-void fetch(instruction_trace_t *trace)
+void fetch(tomasulo_t *m, instruction_trace_t *trace, counter_t current_cycle)
 {
 
   /* ECE552: YOUR CODE GOES HERE */
 
   // the IFQ is full
-  if (instr_queue_size >= INSTR_QUEUE_SIZE)
+  if (m->instr_queue_size >= m->cfg.ifq_size)
     return;
-  // we've fetched all availble instructions
-  if (fetch_index == sim_num_insn)
+  // waiting for a mispredicted branch
+  if (m->fetch_block != NULL || current_cycle < m->fetch_resume)
     return;
 
-  // move to  the next instruction
-  fetch_index++;
-  while (fetch_index < sim_num_insn)
+  instruction_t *instr = NULL;
+  bool taken = false;
+  if (m->stream != NULL)
+  {
+    // the window holds no traps
+    if (m->stream->count == 0)
+      return;
+    tom_window_entry_t *entry = &m->stream->window[m->stream->head];
+    instr = entry->instr;
+    taken = entry->next_pc != instr->pc + sizeof(md_inst_t);
+    ((tom_record_t *)instr)->next_pc = entry->next_pc;
+    m->stream->head = (m->stream->head + 1) % m->stream->capacity;
+    m->stream->count--;
+  }
+  else
   {
-    instruction_t *instr = get_instr(trace, fetch_index);
-    // add instruction to queque if it not a trap
-    if (!IS_TRAP(instr->op))
+    // we've fetched all availble instructions
+    if (m->fetch_index == sim_num_insn)
+      return;
+
+    // move to  the next instruction
+    m->fetch_index++;
+    while (m->fetch_index < sim_num_insn)
+    {
+      instr = get_instr(trace, m->fetch_index);
+      // add instruction to queque if it not a trap
+      if (!IS_TRAP(instr->op))
+      {
+        break;
+      }
+      // else skip to next instrction
+      m->fetch_index++;
+    }
+    if (m->fetch_index == sim_num_insn)
     {
-      instr_queue[instr_queue_size] = instr;
-      instr_queue_size++;
+      // Only traps remained
       return;
     }
-    // else skip to next instrction
-    fetch_index++;
+    taken = IS_COND_CTRL(instr->op) && branch_taken(trace, instr);
   }
 
-  // Only traps remained
-  fetch_index = sim_num_insn;
+  m->instr_queue[(m->instr_queue_head + m->instr_queue_size) % m->cfg.ifq_size] = instr;
+  m->instr_queue_size++;
+
+  if (IS_COND_CTRL(instr->op))
+  {
+    bool pred = m->bpred->get != NULL ? m->bpred->get(m->bpred_state, instr->pc) : taken;
+    m->bpred->update(m->bpred_state, instr->pc, taken, pred, 0);
+    m->num_cond_branches++;
+    if (pred != taken)
+    {
+      m->num_mispred++;
+      m->fetch_block = instr;
+    }
+  }
 }
 
 /*
  * Description:
- * 	Calls fetch and dispatches an instruction at the same cycle (if possible)
+ * 	Calls fetch and dispatches instructions at the same cycle (if possible),
+ *      up to the fetch and dispatch widths, dispatch stops at the first stall
  * Inputs:
+ * 	m: the machine being simulated
  *      trace: instruction trace with all the instructions executed
  * 	current_cycle: the cycle we are at
  * Returns:
  * 	None
  */
-void fetch_To_dispatch(instruction_trace_t *trace, int current_cycle)
+void fetch_To_dispatch(tomasulo_t *m, instruction_trace_t *trace, counter_t current_cycle)
 {
   /* ECE552: YOUR CODE GOES HERE */
 
-  int old_size = instr_queue_size;
-  fetch(trace);
-
-  // if we fetched a new instruction, set its dispatch cycle
-  if (instr_queue_size > old_size)
+  for (int f = 0; f < m->cfg.fetch_width; f++)
   {
-    instr_queue[instr_queue_size - 1]->tom_dispatch_cycle = current_cycle;
-  }
+    int old_size = m->instr_queue_size;
+    fetch(m, trace, current_cycle);
 
-  // nothing to dispatch if IFQ empty
-  if (instr_queue_size == 0)
-  {
-    return;
+    // if we fetched a new instruction, set its dispatch cycle
+    if (m->instr_queue_size == old_size)
+    {
+      break;
+    }
+    if (m->record)
+    {
+      int tail = (m->instr_queue_head + m->instr_queue_size - 1) % m->cfg.ifq_size;
+      m->instr_queue[tail]->tom_dispatch_cycle = current_cycle;
+    }
   }
 
-  // get instruction at the head of the IFQ
-  instruction_t *instr = instr_queue[0];
-
-  // conditional instructions don't use RS or FU, so can dispatch and remove from IFQ
-  if (IS_UNCOND_CTRL(instr->op) || IS_COND_CTRL(instr->op))
+  // dispatch from the head of the IFQ in program order, until it is empty
+  for (int d = 0; d < m->cfg.dispatch_width && m->instr_queue_size > 0; d++)
   {
-    // remove from IFQ
-    remove_instr_from_ifq(instr_queue, &instr_queue_size);
-    return;
-  }
+    // get instruction at the head of the IFQ
+    instruction_t *instr = m->instr_queue[m->instr_queue_head];
+    bool use_rob = m->cfg.rob_size > 0;
 
-  // instructuction uses FU
-  if (USES_INT_FU(instr->op))
-  {
-    int rs_idx = get_free_rs_entry(reservINT, RESERV_INT_SIZE);
-    if (rs_idx != -1)
+    // every instruction needs a reorder buffer entry
+    if (use_rob && m->rob_count == m->cfg.rob_size)
     {
-      // allocate rs entry
-      reservINT[rs_idx] = instr;
+      return;
+    }
 
-      // update map table
-      update_map_table(instr, map_table);
+    // branches don't use RS or FU, so can dispatch and remove from IFQ;
+    // with a reorder buffer conditional branches resolve in the branch unit
+    if (IS_UNCOND_CTRL(instr->op) || (IS_COND_CTRL(instr->op) && !use_rob))
+    {
+      // remove from IFQ
+      remove_instr_from_ifq(m);
+      if (use_rob)
+      {
+        m->rob[rob_push(m, instr)].done_cycle = current_cycle;
+      }
+      else
+      {
+        retire_instr(m, instr);
+      }
+      continue;
+    }
 
-      // remove insturction from IFQ
-      remove_instr_from_ifq(instr_queue, &instr_queue_size);
+    // instructuction uses FU
+    enum fu_type type;
+    if (IS_COND_CTRL(instr->op))
+    {
+      type = BR;
     }
-  }
-  else if (USES_FP_FU(instr->op))
-  {
-    int rs_idx = get_free_rs_entry(reservFP, RESERV_FP_SIZE);
-    if (rs_idx != -1)
+    else if (USES_INT_FU(instr->op))
+    {
+      type = INT;
+    }
+    else if (USES_FP_FU(instr->op))
+    {
+      type = FP;
+    }
+    else
+    {
+      return;
+    }
+
+    // loads and stores need a queue entry
+    lsq_t *q = NULL;
+    if (m->cfg.lq_size > 0 && (IS_LOAD(instr->op) || IS_STORE(instr->op)))
     {
-      // allocate rs entry
-      reservFP[rs_idx] = instr;
+      q = IS_LOAD(instr->op) ? &m->lq : &m->sq;
+      if (q->count == q->size)
+      {
+        return;
+      }
+    }
 
-      // update map table
-      update_map_table(instr, map_table);
+    int slot = alloc_rs_entry(m, type);
+    if (slot == -1)
+    {
+      // if no reservation station available, stall
+      return;
+    }
 
-      // remove instruction from IFQ
-      remove_instr_from_ifq(instr_queue, &instr_queue_size);
+    // allocate rs entry
+    m->reserv[slot] = instr;
+    m->dispatched[m->dispatched_count++] = slot;
+    if (use_rob)
+    {
+      m->rs_sched[slot].rob = rob_push(m, instr);
+      m->rob[m->rs_sched[slot].rob].slot = slot;
+    }
+    if (q != NULL)
+    {
+      m->rs_sched[slot].lsq = lsq_push(q, instr, slot);
     }
-  }
 
-  // if no reservation station available, stall
+    // update map table and register on the producers
+    update_map_table(m, instr, slot);
+
+    // remove insturction from IFQ
+    remove_instr_from_ifq(m);
+  }
 }
 
 /*
@@ -543,260 +1203,1197 @@ void fetch_To_dispatch(instruction_trace_t *trace, int current_cycle)
  * 	The total number of cycles it takes to execute the instructions.
  * Extra Notes:
  * 	sim_num_insn: the number of instructions in the trace
+ *      runs the -tom:* configuration and records its cycles in the trace,
+ *      then the -tom:sweep configurations if one is given
  */
 counter_t runTomasulo(instruction_trace_t *trace)
 {
-  instr_queue_size = 0;
-  fetch_index = 0;
-  commonDataBus = NULL;
-  // initialize instruction queue
-  int i;
-  for (i = 0; i < INSTR_QUEUE_SIZE; i++)
-  {
-    instr_queue[i] = NULL;
-  }
-
-  // initialize reservation stations
-  for (i = 0; i < RESERV_INT_SIZE; i++)
+  tomasulo_t *m = tomasulo_create(&tom_config, true);
+  counter_t cycles = tomasulo_run(m, trace);
+  tom_num_cond_branches = m->num_cond_branches;
+  tom_num_mispred = m->num_mispred;
+  tom_num_load_forwards = m->num_load_forwards;
+  tom_num_mem_violations = m->num_mem_violations;
+  tom_num_squashed = m->num_squashed;
+  tomasulo_free(m);
+
+  if (tom_sweep != NULL && tom_sweep[0] != '\0')
   {
-    reservINT[i] = NULL;
+    tomasulo_sweep(trace);
   }
+  return cycles;
+}
 
-  for (i = 0; i < RESERV_FP_SIZE; i++)
-  {
-    reservFP[i] = NULL;
-  }
+/*
+ * Description:
+ * 	Starts a -tom:stream run with the -tom:* configuration
+ * Inputs:
+ *      retire: called with every instruction simulated once its cycles are final, or NULL
+ * Returns:
+ * 	None
+ */
+void tomasulo_stream_begin(void (*retire)(instruction_t *instr))
+{
+  tomasulo_t *m = tomasulo_create(&tom_config, true);
+  tom_stream_t *stream = tom_alloc(1, sizeof(tom_stream_t));
+  // a fetch group plus the instruction being pushed, and the IFQ and ROB fetched again after a squash
+  stream->capacity = tom_config.fetch_width + 2 + tom_config.ifq_size + tom_config.rob_size;
+  stream->window = tom_alloc(stream->capacity, sizeof(tom_window_entry_t));
+  stream->last = -1;
+  stream->retire = retire;
+  m->stream = stream;
+  tom_stream_machine = m;
+}
 
-  // initialize functional units
-  for (i = 0; i < FU_INT_SIZE; i++)
+/*
+ * Description:
+ * 	Takes a cleared instruction record from the pool
+ * Inputs:
+ * 	None
+ * Returns:
+ * 	The record to fill and push
+ */
+instruction_t *tomasulo_stream_alloc(void)
+{
+  tom_stream_t *stream = tom_stream_machine->stream;
+  tom_record_t *rec = stream->free_list;
+  if (rec != NULL)
   {
-    fuINT[i] = NULL;
+    stream->free_list = rec->next_free;
+    memset(rec, 0, sizeof(tom_record_t));
   }
-
-  for (i = 0; i < FU_FP_SIZE; i++)
+  else
   {
-    fuFP[i] = NULL;
+    rec = tom_alloc(1, sizeof(tom_record_t));
+    stream->num_records++;
   }
+  return &rec->instr;
+}
 
-  // initialize map_table to no producers
-  int reg;
-  for (reg = 0; reg < MD_TOTAL_REGS; reg++)
-  {
-    map_table[reg] = NULL;
-  }
+/*
+ * Description:
+ * 	Hands the next instruction in program order to the engine, simulating
+ *      cycles until the window has room again
+ * Inputs:
+ *      instr: a record from tomasulo_stream_alloc
+ * Returns:
+ * 	None
+ */
+void tomasulo_stream_push(instruction_t *instr)
+{
+  tomasulo_t *m = tom_stream_machine;
+  tom_stream_t *stream = m->stream;
 
-  int cycle = 1;
-  while (true)
+  // the previous instruction now knows where execution went after it
+  if (stream->last != -1)
+  {
+    stream->window[stream->last].next_pc = instr->pc;
+    stream->last = -1;
+  }
+
+  // fetch skips traps
+  if (IS_TRAP(instr->op))
+  {
+    recycle_record(stream, (tom_record_t *)instr);
+    return;
+  }
+
+  int tail = (stream->head + stream->count) % stream->capacity;
+  stream->window[tail].instr = instr;
+  stream->window[tail].next_pc = instr->pc + sizeof(md_inst_t);
+  stream->last = tail;
+  stream->count++;
+
+  while (stream->count > m->cfg.fetch_width)
+  {
+    tomasulo_cycle(m, NULL);
+  }
+}
+
+/*
+ * Description:
+ * 	Simulates the instructions left in the window until the machine is empty
+ * Inputs:
+ * 	None
+ * Returns:
+ * 	The total number of cycles it takes to execute the pushed instructions.
+ */
+counter_t tomasulo_stream_finish(void)
+{
+  tomasulo_t *m = tom_stream_machine;
+  tom_stream_t *stream = m->stream;
+
+  // the last instruction falls through
+  stream->last = -1;
+  stream->done = true;
+  counter_t cycles = tomasulo_run(m, NULL);
+  tom_num_cond_branches = m->num_cond_branches;
+  tom_num_mispred = m->num_mispred;
+  tom_num_load_forwards = m->num_load_forwards;
+  tom_num_mem_violations = m->num_mem_violations;
+  tom_num_squashed = m->num_squashed;
+
+  while (stream->free_list != NULL)
+  {
+    tom_record_t *rec = stream->free_list;
+    stream->free_list = rec->next_free;
+    free(rec);
+  }
+  free(stream->window);
+  free(stream);
+  tomasulo_free(m);
+  tom_stream_machine = NULL;
+  return cycles;
+}
+
+/*
+ * Description:
+ * 	Tells the simulator if -tom:stream is set
+ * Inputs:
+ * 	None
+ * Returns:
+ * 	True: if instructions are to be pushed with tomasulo_stream_push
+ */
+bool tomasulo_stream_enabled(void)
+{
+  return tom_stream;
+}
+
+/* ECE552 Assignment 3 - BEGIN CODE */
+
+// helper function to allocate zeroed memory or die
+void *tom_alloc(size_t count, size_t size)
+{
+  void *p = calloc(count, size);
+  if (p == NULL)
   {
+    fatal("out of virtual memory");
+  }
+  return p;
+}
 
-    /* ECE552: YOUR CODE GOES HERE */
-    CDB_To_retire(cycle);
+// helper function that builds an empty machine for a configuration
+tomasulo_t *tomasulo_create(const tomasulo_config_t *cfg, bool record)
+{
+  tomasulo_t *m = tom_alloc(1, sizeof(tomasulo_t));
+  m->cfg = *cfg;
+  m->record = record;
+  // a branch slot for every reorder buffer entry, so branches never wait for one
+  m->rs_total = cfg->rs_size[INT] + cfg->rs_size[FP] + cfg->rob_size;
 
-    // Stage 4: Move from Execute to CDB
-    execute_To_CDB(cycle);
+  // initialize instruction queue
+  m->instr_queue = tom_alloc(cfg->ifq_size, sizeof(instruction_t *));
+  m->commonDataBus = tom_alloc(cfg->num_cdbs, sizeof(instruction_t *));
+
+  // initialize reservation stations and the scheduler
+  m->reserv = tom_alloc(m->rs_total, sizeof(instruction_t *));
+  m->rs_sched = tom_alloc(m->rs_total, sizeof(rs_sched_t));
+  m->wakeup_next = tom_alloc(3 * m->rs_total, sizeof(int));
+  for (int i = 0; i < m->rs_total; i++)
+  {
+    m->rs_sched[i].waiters = -1;
+    m->rs_sched[i].wheel_next = -1;
+  }
+  // free lists are popped from the back, so the lowest slot goes first
+  for (int type = INT; type <= BR; type++)
+  {
+    int first = type == INT ? 0 : type == FP ? cfg->rs_size[INT] : cfg->rs_size[INT] + cfg->rs_size[FP];
+    int size = type == BR ? cfg->rob_size : cfg->rs_size[type];
+    m->rs_free[type].slot = tom_alloc(size, sizeof(int));
+    if (type != BR)
+    {
+      m->ready[type].slot = tom_alloc(size, sizeof(int));
+    }
+    for (int i = first + size - 1; i >= first; i--)
+    {
+      m->rs_free[type].slot[m->rs_free[type].size++] = i;
+    }
+  }
+  m->completed.slot = tom_alloc(m->rs_total, sizeof(int));
+  m->wake_queue = tom_alloc(m->rs_total, sizeof(int));
+  m->wake_cycle = tom_alloc(m->rs_total, sizeof(counter_t));
+  m->dispatched = tom_alloc(m->rs_total, sizeof(int));
+
+  // FU completions are at most the longest latency ahead
+  m->wheel_size = (cfg->fu_latency[INT] > cfg->fu_latency[FP] ? cfg->fu_latency[INT] : cfg->fu_latency[FP]) + 1;
+  if (cfg->lq_size > 0 && cfg->fwd_latency >= m->wheel_size)
+  {
+    m->wheel_size = cfg->fwd_latency + 1;
+  }
+  if (cfg->rob_size > 0 && cfg->br_latency >= m->wheel_size)
+  {
+    m->wheel_size = cfg->br_latency + 1;
+  }
+  m->wheel = tom_alloc(m->wheel_size, sizeof(int));
+  for (int i = 0; i < m->wheel_size; i++)
+  {
+    m->wheel[i] = -1;
+  }
 
-    // Stage 3: Move from Issue to Execute
-    issue_To_execute(cycle);
+  // initialize map_table to no producers
+  for (int reg = 0; reg < MD_TOTAL_REGS; reg++)
+  {
+    m->map_table[reg] = NULL;
+    m->map_slot[reg] = -1;
+  }
 
-    // Stage 2: Move from Dispatch to Issue
-    dispatch_To_issue(cycle);
+  if (cfg->rob_size > 0)
+  {
+    m->rob = tom_alloc(cfg->rob_size, sizeof(rob_entry_t));
+  }
+  if (cfg->lq_size > 0)
+  {
+    m->lq.size = cfg->lq_size;
+    m->lq.entry = tom_alloc(cfg->lq_size, sizeof(lsq_entry_t));
+    m->sq.size = cfg->sq_size;
+    m->sq.entry = tom_alloc(cfg->sq_size, sizeof(lsq_entry_t));
+  }
+  m->bpred = find_bpred(cfg->bpred);
+  m->bpred_state = m->bpred->init();
+  m->cycle = 1;
+  return m;
+}
 
-    // Stage 1: Fetch and Dispatch
-    fetch_To_dispatch(trace, cycle);
+// helper function that releases a machine
+void tomasulo_free(tomasulo_t *m)
+{
+  free(m->instr_queue);
+  free(m->commonDataBus);
+  free(m->reserv);
+  free(m->rs_sched);
+  free(m->wakeup_next);
+  for (int type = INT; type <= FP; type++)
+  {
+    free(m->rs_free[type].slot);
+    free(m->ready[type].slot);
+  }
+  free(m->rs_free[BR].slot);
+  free(m->completed.slot);
+  free(m->wake_queue);
+  free(m->wake_cycle);
+  free(m->dispatched);
+  free(m->wheel);
+  free(m->rob);
+  free(m->lq.entry);
+  free(m->sq.entry);
+  free(m->bpred_state);
+  free(m);
+}
 
-    cycle++;
+// helper function that simulates the trace on a machine, returns the cycles
+counter_t tomasulo_run(tomasulo_t *m, instruction_trace_t *trace)
+{
+  while (true)
+  {
+    tomasulo_cycle(m, trace);
 
-    if (is_simulation_done(sim_num_insn))
+    if (is_simulation_done(m, sim_num_insn))
       break;
   }
 
-  return cycle;
+  return m->cycle;
 }
 
-/* ECE552 Assignment 3 - BEGIN CODE */
+// helper function that simulates one cycle
+void tomasulo_cycle(tomasulo_t *m, instruction_trace_t *trace)
+{
+  /* ECE552: YOUR CODE GOES HERE */
+  ROB_To_commit(m, m->cycle);
+
+  CDB_To_retire(m, m->cycle);
+
+  // Stage 4: Move from Execute to CDB
+  execute_To_CDB(m, m->cycle);
+
+  // Stage 3: Move from Issue to Execute
+  issue_To_execute(m, m->cycle);
+
+  // Stage 2: Move from Dispatch to Issue
+  dispatch_To_issue(m, m->cycle);
+
+  // Stage 1: Fetch and Dispatch
+  fetch_To_dispatch(m, trace, m->cycle);
+
+  m->cycle++;
+}
+
+/* SWEEP */
+/*
+ * -tom:sweep "rs_int=2:16:2,fu_int=1:4" runs the cross product of the
+ * listed ranges over the trace that is already loaded, every parameter
+ * not listed keeping its -tom:* value. The configurations are handed out
+ * to -tom:threads workers, each building its own machine, and printed in
+ * sweep order once all of them are done:
+ *
+ *   tom_sweep ifq rs_int rs_fp fu_int fu_fp lat_int lat_fp fetch_width
+ *             dispatch_width issue_width cdbs rob commit_width
+ *             redirect_penalty lat_br lq sq spec_loads lat_fwd cycles ipc
+ *
+ * All of them use the -tom:bpred predictor, and every one must be a
+ * valid configuration on its own. At most TOM_SWEEP_MAX_CONFIGS
+ * configurations are run.
+ */
+
+#define TOM_SWEEP_MAX_CONFIGS 1000000
+
+typedef struct
+{
+  instruction_trace_t *trace;
+  tomasulo_config_t *configs;
+  counter_t *cycles;
+  int num_configs;
+  int next_config;
+  pthread_mutex_t lock;
+} sweep_t;
+
+// helper function that returns a configuration field by its tom_param_name index
+int *tom_param(tomasulo_config_t *cfg, int param)
+{
+  return (int *)((char *)cfg + tom_param_offset[param]);
+}
 
-// helper function that searches for a free rs entry and returns index
-int get_free_rs_entry(instruction_t **rs, int size)
+// helper function for the sweep workers, runs configurations until none are left
+void *sweep_worker(void *arg)
 {
-  for (int idx = 0; idx < size; idx++)
+  sweep_t *sweep = arg;
+  while (true)
   {
-    if (rs[idx] == NULL)
+    pthread_mutex_lock(&sweep->lock);
+    int i = sweep->next_config++;
+    pthread_mutex_unlock(&sweep->lock);
+    if (i >= sweep->num_configs)
     {
-      return idx;
+      return NULL;
     }
+
+    tomasulo_t *m = tomasulo_create(&sweep->configs[i], false);
+    sweep->cycles[i] = tomasulo_run(m, sweep->trace);
+    tomasulo_free(m);
   }
-  return -1; // no free rs entries
 }
 
-// helper function to update RAW dependencies and map table
-void update_map_table(instruction_t *instr, instruction_t **map_table)
+// helper function that runs the -tom:sweep configurations in parallel
+void tomasulo_sweep(instruction_trace_t *trace)
 {
-  // Mark RAW dependencies using map table
-  for (int i = 0; i < 3; i++)
+  int lo[TOM_NUM_PARAMS], hi[TOM_NUM_PARAMS], step[TOM_NUM_PARAMS];
+  for (int p = 0; p < TOM_NUM_PARAMS; p++)
+  {
+    lo[p] = hi[p] = *tom_param(&tom_config, p);
+    step[p] = 1;
+  }
+
+  // parse <param>=<lo>[:<hi>[:<step>]],...
+  char *spec = tom_alloc(strlen(tom_sweep) + 1, 1);
+  strcpy(spec, tom_sweep);
+  for (char *item = strtok(spec, ","); item != NULL; item = strtok(NULL, ","))
+  {
+    char *value = strchr(item, '=');
+    int p = 0;
+    if (value != NULL)
+    {
+      *value++ = '\0';
+      while (p < TOM_NUM_PARAMS && strcmp(item, tom_param_name[p]) != 0)
+      {
+        p++;
+      }
+    }
+    if (value == NULL || p == TOM_NUM_PARAMS)
+    {
+      fatal("bad -tom:sweep parameter `%s'", item);
+    }
+    int n = sscanf(value, "%d:%d:%d", &lo[p], &hi[p], &step[p]);
+    if (n < 2)
+    {
+      hi[p] = lo[p];
+    }
+    if (n < 1 || lo[p] < tom_param_min[p] || hi[p] < lo[p] || hi[p] > TOM_PARAM_MAX || step[p] < 1)
+    {
+      fatal("bad -tom:sweep range `%s=%s'", item, value);
+    }
+  }
+  free(spec);
+
+  // cross product, the last parameter varies fastest
+  sweep_t sweep;
+  sweep.trace = trace;
+  long long num_configs = 1;
+  for (int p = 0; p < TOM_NUM_PARAMS; p++)
   {
-    if (instr->r_in[i] != DNA && instr->r_in[i] != 0)
+    num_configs *= (hi[p] - lo[p]) / step[p] + 1;
+    if (num_configs > TOM_SWEEP_MAX_CONFIGS)
     {
-      instr->Q[i] = map_table[instr->r_in[i]];
+      fatal("-tom:sweep has more than %d configurations", TOM_SWEEP_MAX_CONFIGS);
     }
-    else
+  }
+  sweep.num_configs = (int)num_configs;
+  sweep.configs = tom_alloc(sweep.num_configs, sizeof(tomasulo_config_t));
+  sweep.cycles = tom_alloc(sweep.num_configs, sizeof(counter_t));
+  for (int i = 0; i < sweep.num_configs; i++)
+  {
+    int rest = i;
+    sweep.configs[i] = tom_config;
+    for (int p = TOM_NUM_PARAMS - 1; p >= 0; p--)
+    {
+      int count = (hi[p] - lo[p]) / step[p] + 1;
+      *tom_param(&sweep.configs[i], p) = lo[p] + (rest % count) * step[p];
+      rest /= count;
+    }
+    const char *error = config_error(&sweep.configs[i]);
+    if (error != NULL)
     {
-      instr->Q[i] = NULL;
+      fatal("-tom:sweep configuration %d: %s", i, error);
     }
   }
+  sweep.next_config = 0;
+  pthread_mutex_init(&sweep.lock, NULL);
 
-  // Update map table for output registers
-  for (int i = 0; i < 2; i++)
+  int num_threads = tom_threads > 0 ? tom_threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (num_threads < 1)
   {
-    if (instr->r_out[i] != DNA && instr->r_out[i] != 0)
+    num_threads = 1;
+  }
+  if (num_threads > sweep.num_configs)
+  {
+    num_threads = sweep.num_configs;
+  }
+  pthread_t *threads = tom_alloc(num_threads, sizeof(pthread_t));
+  for (int t = 0; t < num_threads; t++)
+  {
+    if (pthread_create(&threads[t], NULL, sweep_worker, &sweep) != 0)
+    {
+      fatal("cannot create sweep thread");
+    }
+  }
+  for (int t = 0; t < num_threads; t++)
+  {
+    pthread_join(threads[t], NULL);
+  }
+
+  myfprintf(stdout, "tom_sweep");
+  for (int p = 0; p < TOM_NUM_PARAMS; p++)
+  {
+    myfprintf(stdout, " %s", tom_param_name[p]);
+  }
+  myfprintf(stdout, " cycles ipc\n");
+  for (int i = 0; i < sweep.num_configs; i++)
+  {
+    myfprintf(stdout, "tom_sweep");
+    for (int p = 0; p < TOM_NUM_PARAMS; p++)
     {
-      map_table[instr->r_out[i]] = instr;
+      myfprintf(stdout, " %d", *tom_param(&sweep.configs[i], p));
     }
+    myfprintf(stdout, " %lld %.4f\n", (long long)sweep.cycles[i],
+              (double)sim_num_insn / (double)sweep.cycles[i]);
   }
+
+  pthread_mutex_destroy(&sweep.lock);
+  free(threads);
+  free(sweep.configs);
+  free(sweep.cycles);
 }
 
-// helper function to remove insturuction from ifq
-void remove_instr_from_ifq(instruction_t **instr_queue, int *instr_queue_size)
+// helper function that compares program order, index may wrap around
+bool older(instruction_t *a, instruction_t *b)
+{
+  return (int)((unsigned)a->index - (unsigned)b->index) < 0;
+}
+
+// helper function for instructions leaving the machine, recycles their record when streaming
+void retire_instr(tomasulo_t *m, instruction_t *instr)
 {
-  if (*instr_queue_size <= 0)
+  if (m->stream == NULL)
   {
-    return; // nothing to remove
+    return;
   }
-  else
+  if (m->stream->retire != NULL)
   {
-    for (int i = 0; i < *instr_queue_size - 1; i++)
+    m->stream->retire(instr);
+  }
+
+  // later consumers read the register file
+  for (int i = 0; i < 2; i++)
+  {
+    if (instr->r_out[i] != DNA && instr->r_out[i] != 0 && m->map_table[instr->r_out[i]] == instr)
     {
-      instr_queue[i] = instr_queue[i + 1];
+      m->map_table[instr->r_out[i]] = NULL;
     }
-    *instr_queue_size = *instr_queue_size - 1;
-    instr_queue[*instr_queue_size] = NULL;
+  }
+
+  tom_record_t *rec = (tom_record_t *)instr;
+  rec->retired = true;
+  if (rec->refs == 0)
+  {
+    recycle_record(m->stream, rec);
+  }
+}
+
+// helper function for a consumer dropping its Q pointer to a producer
+void unref_instr(tomasulo_t *m, instruction_t *instr)
+{
+  if (m->stream == NULL)
+  {
     return;
   }
+  tom_record_t *rec = (tom_record_t *)instr;
+  rec->refs--;
+  if (rec->refs == 0 && rec->retired)
+  {
+    recycle_record(m->stream, rec);
+  }
 }
 
-// helper function to dispatch valid instructions
-void issue_rdy_instr(instruction_t **rs, int rs_size, int current_cycle)
+// helper function that returns a record to the pool
+void recycle_record(tom_stream_t *stream, tom_record_t *rec)
 {
-  for (int entry = 0; entry < rs_size; entry++)
+  rec->next_free = stream->free_list;
+  stream->free_list = rec;
+}
+
+// helper function that looks up a -tom:bpred predictor, NULL if unknown
+const tom_bpred_t *find_bpred(const char *name)
+{
+  for (int i = 0; i < TOM_NUM_BPREDS; i++)
   {
-    if (rs[entry] != NULL)
+    if (strcmp(name, tom_bpreds[i].name) == 0)
     {
-      instruction_t *instr = rs[entry];
-
-      if (instr->tom_dispatch_cycle < current_cycle && instr->tom_dispatch_cycle > 0 && instr->tom_issue_cycle == 0)
-      {
-        instr->tom_issue_cycle = current_cycle;
-      }
+      return &tom_bpreds[i];
     }
   }
-  return;
+  return NULL;
 }
 
-// helper function to check if instr has dispatched
-bool instr_dispatched(instruction_t *instr, int current_cycle)
+// helper function that checks the parameters that depend on each other, returns NULL if they are fine
+const char *config_error(const tomasulo_config_t *cfg)
 {
-  return (instr->tom_dispatch_cycle < current_cycle && instr->tom_dispatch_cycle > 0 && instr->tom_issue_cycle == 0);
+  const tom_bpred_t *bpred = find_bpred(cfg->bpred);
+  if (bpred == NULL)
+  {
+    return "unknown -tom:bpred";
+  }
+  if (bpred->get != NULL && cfg->rob_size == 0)
+  {
+    return "-tom:bpred other than perfect needs a reorder buffer (-tom:rob)";
+  }
+  if ((cfg->lq_size == 0) != (cfg->sq_size == 0))
+  {
+    return "-tom:lq and -tom:sq must both be 0 or both be set";
+  }
+  if (cfg->lq_size > 0 && cfg->rob_size == 0)
+  {
+    return "the load/store queue needs a reorder buffer (-tom:rob)";
+  }
+  if (cfg->spec_loads && cfg->lq_size == 0)
+  {
+    return "-tom:spec_loads needs a load/store queue (-tom:lq, -tom:sq)";
+  }
+  return NULL;
 }
 
-// helper function to check if instr has issued
-bool instr_issued(instruction_t *instr, int current_cycle)
+// helper function that tells if a conditional branch was taken from the next instruction in the trace
+bool branch_taken(instruction_trace_t *trace, instruction_t *instr)
 {
-  return (instr->tom_issue_cycle < current_cycle && instr->tom_issue_cycle > 0 && instr->tom_execute_cycle == 0);
+  if (instr->index + 1 > sim_num_insn)
+  {
+    return false;
+  }
+  return get_instr(trace, instr->index + 1)->pc != instr->pc + sizeof(md_inst_t);
 }
 
-// helper function to check if instr executed
-bool instr_executed(instruction_t *instr, int current_cycle, int latency)
+// helper function that appends an instruction to the reorder buffer, returns its entry
+int rob_push(tomasulo_t *m, instruction_t *instr)
 {
-  return (current_cycle >= instr->tom_execute_cycle + latency && instr->tom_execute_cycle > 0);
+  int tail = (m->rob_head + m->rob_count) % m->cfg.rob_size;
+  m->rob[tail].instr = instr;
+  m->rob[tail].done_cycle = 0;
+  m->rob[tail].slot = -1;
+  m->rob_count++;
+  return tail;
 }
 
-// helper function to check if all instr opearands are available
-bool instr_ready_to_execute(instruction_t *instr, int current_cycle)
+// helper function that marks the instruction in an rs slot finished, and redirects fetch after a misprediction
+void complete_instr(tomasulo_t *m, int slot, counter_t cycle)
 {
-  if (instr == NULL)
-    return false;
+  if (m->cfg.rob_size > 0)
+  {
+    m->rob[m->rs_sched[slot].rob].done_cycle = cycle;
+  }
+  if (m->reserv[slot] == m->fetch_block)
+  {
+    m->fetch_block = NULL;
+    m->fetch_resume = cycle + 1 + m->cfg.redirect_penalty;
+  }
+}
 
-  if (!instr_issued(instr, current_cycle))
-    return false;
+// helper function that appends a memory instruction to its queue, returns its entry
+int lsq_push(lsq_t *q, instruction_t *instr, int slot)
+{
+  int tail = (q->head + q->count) % q->size;
+  lsq_entry_t *entry = &q->entry[tail];
+  memset(entry, 0, sizeof(lsq_entry_t));
+  entry->instr = instr;
+  entry->slot = slot;
+  q->count++;
+  return tail;
+}
 
-  for (int j = 0; j < 3; j++)
+// helper function that looks for an older store a load has to wait for or can forward from
+enum load_check disambiguate_load(tomasulo_t *m, lsq_entry_t *load, counter_t cycle)
+{
+  bool retry = false;
+  load->forwarded = false;
+  // youngest store first
+  for (int i = m->sq.count - 1; i >= 0; i--)
   {
-    if (instr->Q[j] != NULL)
+    lsq_entry_t *store = &m->sq.entry[(m->sq.head + i) % m->sq.size];
+    if (!older(store->instr, load->instr))
+    {
+      continue;
+    }
+    bool alias = store->instr->mem_addr >> 3 == load->instr->mem_addr >> 3;
+    if (store->done_cycle == 0)
     {
-      // Dependency not resolved if producer hasn't completed CDB
-      if (instr->Q[j]->tom_cdb_cycle == 0 || instr->Q[j]->tom_cdb_cycle >= current_cycle)
+      if (!m->cfg.spec_loads)
       {
-        return false;
+        return LOAD_BLOCKED;
       }
     }
+    else if (store->done_cycle == cycle)
+    {
+      // finished this cycle, after the loads it would have caught were checked
+      if (!load->forwarded && (alias || !m->cfg.spec_loads))
+      {
+        retry = true;
+      }
+    }
+    else if (alias && !load->forwarded)
+    {
+      load->forwarded = true;
+      load->fwd_index = store->instr->index;
+    }
   }
-  return true;
+  return retry ? LOAD_RETRY : LOAD_ISSUE;
 }
 
-// helper function to sort by oldest instructions
-void sort_instr(instruction_t **instr_array, int instr_count)
+// helper function for a store that finished, wakes the blocked loads and catches the loads that ran ahead of it
+void store_done(tomasulo_t *m, lsq_entry_t *store, counter_t cycle)
 {
-  if (instr_count == 0)
-    return;
-
-  for (int i = 0; i < instr_count - 1; i++)
+  store->done_cycle = cycle;
+  for (int i = 0; i < m->lq.count; i++)
   {
-    for (int j = i + 1; j < instr_count; j++)
+    lsq_entry_t *load = &m->lq.entry[(m->lq.head + i) % m->lq.size];
+    if (load->blocked)
+    {
+      load->blocked = false;
+      wake_push(m, load->slot, cycle + 1);
+      continue;
+    }
+    if (!m->cfg.spec_loads || !load->issued || load->replay || !older(store->instr, load->instr) ||
+        store->instr->mem_addr >> 3 != load->instr->mem_addr >> 3)
+    {
+      continue;
+    }
+    // the load got the value of this store or a younger one
+    if (load->forwarded && (int)((unsigned)store->instr->index - (unsigned)load->fwd_index) < 0)
     {
-      if (instr_array[i]->index > instr_array[j]->index)
+      continue;
+    }
+
+    m->num_mem_violations++;
+    if (load->broadcast)
+    {
+      // squashed once the stores finishing this cycle are done
+      if (m->squash_from == NULL || older(load->instr, m->squash_from))
       {
-        instruction_t *temp = instr_array[i];
-        instr_array[i] = instr_array[j];
-        instr_array[j] = temp;
+        m->squash_from = load->instr;
       }
     }
+    else
+    {
+      load->replay = true;
+    }
   }
 }
 
-// helper function to allocate FU
-void allocate_fu(instruction_t **ready_instr, int ready_count, instruction_t **fu, int fu_size, int current_cycle)
+// helper function that sends a load with a stale value back to execute
+void replay_load(tomasulo_t *m, int slot, counter_t cycle)
 {
-  int num_fu_entry_allocated = 0;
-  for (int i = 0; i < ready_count && num_fu_entry_allocated < fu_size; i++)
+  lsq_entry_t *load = &m->lq.entry[m->rs_sched[slot].lsq];
+  load->replay = false;
+  load->issued = false;
+  m->fu_busy[INT]--;
+  wake_push(m, slot, cycle + 1);
+}
+
+// helper function that tells if an rs slot holds first or an instruction younger than it
+bool slot_squashed(tomasulo_t *m, int slot, instruction_t *first)
+{
+  return m->reserv[slot] != NULL && !older(m->reserv[slot], first);
+}
+
+// helper function that drops the squashed slots from a heap, giving back the FUs they hold
+void heap_squash(tomasulo_t *m, slot_heap_t *heap, instruction_t *first, bool holds_fu)
+{
+  int size = heap->size;
+  heap->size = 0;
+  for (int i = 0; i < size; i++)
   {
-    instruction_t *instr = ready_instr[i];
+    int slot = heap->slot[i];
+    if (!slot_squashed(m, slot, first))
+    {
+      heap_push(m, heap, slot);
+    }
+    else if (holds_fu)
+    {
+      m->fu_busy[slot_fu_type(m, slot)]--;
+    }
+  }
+}
 
-    for (int j = 0; j < fu_size; j++)
+// helper function that squashes first and every younger instruction in flight, and fetches them again
+void squash_from(tomasulo_t *m, instruction_t *first, counter_t cycle)
+{
+  // drop the squashed consumers from the wakeup lists of the older producers
+  for (int slot = 0; slot < m->rs_total; slot++)
+  {
+    if (m->reserv[slot] == NULL || slot_squashed(m, slot, first))
+    {
+      continue;
+    }
+    int *node = &m->rs_sched[slot].waiters;
+    while (*node != -1)
     {
-      if (fu[j] == NULL)
+      if (slot_squashed(m, *node / 3, first))
       {
-        fu[j] = instr;
-        instr->tom_execute_cycle = current_cycle;
+        *node = m->wakeup_next[*node];
+      }
+      else
+      {
+        node = &m->wakeup_next[*node];
+      }
+    }
+  }
 
-        // Clear Q dependencies (no longer needed in execute)
-        for (int k = 0; k < 3; k++)
+  // and from the scheduler, giving back the FUs of the ones executing
+  for (int bucket = 0; bucket < m->wheel_size; bucket++)
+  {
+    int *slot = &m->wheel[bucket];
+    while (*slot != -1)
+    {
+      if (slot_squashed(m, *slot, first))
+      {
+        if (slot_fu_type(m, *slot) != BR)
         {
-          instr->Q[k] = NULL;
+          m->fu_busy[slot_fu_type(m, *slot)]--;
         }
+        *slot = m->rs_sched[*slot].wheel_next;
+      }
+      else
+      {
+        slot = &m->rs_sched[*slot].wheel_next;
+      }
+    }
+  }
+  heap_squash(m, &m->completed, first, true);
+  heap_squash(m, &m->ready[INT], first, false);
+  heap_squash(m, &m->ready[FP], first, false);
+  int kept = 0;
+  for (int i = 0; i < m->wake_count; i++)
+  {
+    int from = (m->wake_head + i) % m->rs_total;
+    if (!slot_squashed(m, m->wake_queue[from], first))
+    {
+      int to = (m->wake_head + kept++) % m->rs_total;
+      m->wake_queue[to] = m->wake_queue[from];
+      m->wake_cycle[to] = m->wake_cycle[from];
+    }
+  }
+  m->wake_count = kept;
+  kept = 0;
+  for (int i = 0; i < m->dispatched_count; i++)
+  {
+    if (!slot_squashed(m, m->dispatched[i], first))
+    {
+      m->dispatched[kept++] = m->dispatched[i];
+    }
+  }
+  m->dispatched_count = kept;
+  for (int slot = 0; slot < m->rs_total; slot++)
+  {
+    if (slot_squashed(m, slot, first))
+    {
+      release_rs_entry(m, slot);
+    }
+  }
 
-        // IMPORTANT: Do NOT free the reservation station here!
-        // The instruction keeps its RS entry until it gets the CDB
-        // This was the key change from before
+  // the queues keep the older memory instructions
+  lsq_t *queues[2] = {&m->lq, &m->sq};
+  for (int i = 0; i < 2; i++)
+  {
+    lsq_t *q = queues[i];
+    while (q->count > 0 && !older(q->entry[(q->head + q->count - 1) % q->size].instr, first))
+    {
+      q->entry[(q->head + q->count - 1) % q->size].instr = NULL;
+      q->count--;
+    }
+  }
 
-        num_fu_entry_allocated++;
-        break;
+  // the IFQ is younger than the ROB, youngest goes back to fetch first
+  while (m->instr_queue_size > 0)
+  {
+    int tail = (m->instr_queue_head + m->instr_queue_size - 1) % m->cfg.ifq_size;
+    refetch_instr(m, m->instr_queue[tail]);
+    m->instr_queue[tail] = NULL;
+    m->instr_queue_size--;
+    m->num_squashed++;
+  }
+
+  // registers written by squashed instructions go back to the youngest older producer
+  bool restore[MD_TOTAL_REGS] = {false};
+  while (m->rob_count > 0)
+  {
+    rob_entry_t *entry = &m->rob[(m->rob_head + m->rob_count - 1) % m->cfg.rob_size];
+    instruction_t *instr = entry->instr;
+    if (older(instr, first))
+    {
+      break;
+    }
+    for (int i = 0; i < 2; i++)
+    {
+      if (instr->r_out[i] != DNA && instr->r_out[i] != 0)
+      {
+        restore[instr->r_out[i]] = true;
+        m->map_table[instr->r_out[i]] = NULL;
+        m->map_slot[instr->r_out[i]] = -1;
+      }
+    }
+    if (m->record)
+    {
+      for (int k = 0; k < 3; k++)
+      {
+        if (instr->Q[k] != NULL)
+        {
+          unref_instr(m, instr->Q[k]);
+        }
+        instr->Q[k] = NULL;
+      }
+    }
+    refetch_instr(m, instr);
+    entry->instr = NULL;
+    entry->done_cycle = 0;
+    m->rob_count--;
+    m->num_squashed++;
+  }
+  for (int i = 0; i < m->rob_count; i++)
+  {
+    rob_entry_t *entry = &m->rob[(m->rob_head + i) % m->cfg.rob_size];
+    for (int j = 0; j < 2; j++)
+    {
+      int reg = entry->instr->r_out[j];
+      if (reg != DNA && reg != 0 && restore[reg])
+      {
+        m->map_table[reg] = entry->instr;
+        // still in its RS entry until it writes the CDB
+        m->map_slot[reg] = entry->slot != -1 && m->reserv[entry->slot] == entry->instr ? entry->slot : -1;
       }
     }
   }
-  return;
+
+  // fetch again from the load after the redirect penalty
+  if (m->stream == NULL)
+  {
+    m->fetch_index = first->index - 1;
+  }
+  if (m->fetch_block != NULL && !older(m->fetch_block, first))
+  {
+    m->fetch_block = NULL;
+  }
+  counter_t resume = cycle + 1 + m->cfg.redirect_penalty;
+  if (m->fetch_resume < resume)
+  {
+    m->fetch_resume = resume;
+  }
 }
 
-// helper function to free RS entry
-void free_entry(instruction_t **table, int size, instruction_t *instr)
+// helper function that puts a squashed instruction back in front of the stream window, youngest first
+void refetch_instr(tomasulo_t *m, instruction_t *instr)
 {
-  for (int i = 0; i < size; i++)
+  tom_stream_t *stream = m->stream;
+  if (stream == NULL)
+  {
+    return;
+  }
+  stream->head = (stream->head + stream->capacity - 1) % stream->capacity;
+  stream->window[stream->head].instr = instr;
+  stream->window[stream->head].next_pc = ((tom_record_t *)instr)->next_pc;
+  stream->count++;
+}
+
+// helper function that returns the fu type of an rs slot
+enum fu_type slot_fu_type(tomasulo_t *m, int slot)
+{
+  if (slot < m->cfg.rs_size[INT])
+  {
+    return INT;
+  }
+  return slot < m->cfg.rs_size[INT] + m->cfg.rs_size[FP] ? FP : BR;
+}
+
+// helper function that sends an rs slot to execute for latency cycles, it keeps the entry until it gets the CDB
+void start_execute(tomasulo_t *m, int slot, int latency, counter_t cycle)
+{
+  instruction_t *instr = m->reserv[slot];
+  if (m->record)
+  {
+    instr->tom_execute_cycle = cycle;
+    // Clear Q dependencies (no longer needed in execute)
+    for (int k = 0; k < 3; k++)
+    {
+      if (instr->Q[k] != NULL)
+      {
+        unref_instr(m, instr->Q[k]);
+      }
+      instr->Q[k] = NULL;
+    }
+  }
+
+  int bucket = (cycle + latency) % m->wheel_size;
+  m->rs_sched[slot].wheel_next = m->wheel[bucket];
+  m->wheel[bucket] = slot;
+}
+
+// helper function that adds a slot to a heap ordered by program order
+void heap_push(tomasulo_t *m, slot_heap_t *heap, int slot)
+{
+  int i = heap->size++;
+  while (i > 0)
+  {
+    int parent = (i - 1) / 2;
+    if (!older(m->reserv[slot], m->reserv[heap->slot[parent]]))
+    {
+      break;
+    }
+    heap->slot[i] = heap->slot[parent];
+    i = parent;
+  }
+  heap->slot[i] = slot;
+}
+
+// helper function that removes and returns the oldest slot of a heap
+int heap_pop(tomasulo_t *m, slot_heap_t *heap)
+{
+  int top = heap->slot[0];
+  int last = heap->slot[--heap->size];
+  int i = 0;
+  while (true)
   {
-    if (table[i] == instr)
+    int child = 2 * i + 1;
+    if (child >= heap->size)
     {
-      table[i] = NULL;
       break;
     }
+    if (child + 1 < heap->size && older(m->reserv[heap->slot[child + 1]], m->reserv[heap->slot[child]]))
+    {
+      child++;
+    }
+    if (!older(m->reserv[heap->slot[child]], m->reserv[last]))
+    {
+      break;
+    }
+    heap->slot[i] = heap->slot[child];
+    i = child;
+  }
+  if (heap->size > 0)
+  {
+    heap->slot[i] = last;
+  }
+  return top;
+}
+
+// helper function that queues a slot to become ready at cycle
+void wake_push(tomasulo_t *m, int slot, counter_t cycle)
+{
+  int tail = (m->wake_head + m->wake_count) % m->rs_total;
+  m->wake_queue[tail] = slot;
+  m->wake_cycle[tail] = cycle;
+  m->wake_count++;
+}
+
+// helper function that takes a free rs entry, returns -1 if there is none
+int alloc_rs_entry(tomasulo_t *m, enum fu_type type)
+{
+  if (m->rs_free[type].size == 0)
+  {
+    return -1; // no free rs entries
+  }
+  return m->rs_free[type].slot[--m->rs_free[type].size];
+}
+
+// helper function to free an rs entry and its scheduler state
+void release_rs_entry(tomasulo_t *m, int slot)
+{
+  slot_heap_t *free_list = &m->rs_free[slot_fu_type(m, slot)];
+  m->reserv[slot] = NULL;
+  m->rs_sched[slot].pending = 0;
+  m->rs_sched[slot].issued = false;
+  m->rs_sched[slot].waiters = -1;
+  m->rs_sched[slot].wheel_next = -1;
+  free_list->slot[free_list->size++] = slot;
+}
+
+// helper function to update RAW dependencies and map table
+void update_map_table(tomasulo_t *m, instruction_t *instr, int slot)
+{
+  // Mark RAW dependencies using map table
+  for (int i = 0; i < 3; i++)
+  {
+    int reg = instr->r_in[i];
+    bool named = reg != DNA && reg != 0;
+    if (m->record)
+    {
+      instr->Q[i] = named ? m->map_table[reg] : NULL;
+      if (instr->Q[i] != NULL && m->stream != NULL)
+      {
+        ((tom_record_t *)instr->Q[i])->refs++;
+      }
+    }
+
+    // wait for a producer that has not written the CDB yet
+    if (named && m->map_slot[reg] != -1)
+    {
+      int producer = m->map_slot[reg];
+      int node = 3 * slot + i;
+      m->wakeup_next[node] = m->rs_sched[producer].waiters;
+      m->rs_sched[producer].waiters = node;
+      m->rs_sched[slot].pending++;
+    }
+  }
+
+  // Update map table for output registers
+  for (int i = 0; i < 2; i++)
+  {
+    if (instr->r_out[i] != DNA && instr->r_out[i] != 0)
+    {
+      m->map_table[instr->r_out[i]] = instr;
+      m->map_slot[instr->r_out[i]] = slot;
+    }
+  }
+}
+
+// helper function to remove insturuction from ifq
+void remove_instr_from_ifq(tomasulo_t *m)
+{
+  if (m->instr_queue_size <= 0)
+  {
+    return; // nothing to remove
+  }
+  else
+  {
+    m->instr_queue[m->instr_queue_head] = NULL;
+    m->instr_queue_head = (m->instr_queue_head + 1) % m->cfg.ifq_size;
+    m->instr_queue_size--;
+    return;
+  }
+}
+
+/* DIRECTION PREDICTORS */
+
+// perfect, taken and nottaken keep no state
+void *bpred_static_init(void)
+{
+  return NULL;
+}
+
+bool bpred_taken_get(void *state, md_addr_t PC)
+{
+  return true;
+}
+
+bool bpred_nottaken_get(void *state, md_addr_t PC)
+{
+  return false;
+}
+
+void bpred_static_update(void *state, md_addr_t PC, bool resolveDir, bool predDir, md_addr_t branchTarget)
+{
+}
+
+// 2-bit saturating counters, taken from 2 up, starting weakly not taken
+#define BPRED_CTR_WEAK_NOT_TAKEN 1
+
+// lab 2 indexes x86 byte PCs; PISA instructions are sizeof(md_inst_t) aligned,
+// so the predictors index with the bits above the instruction size instead
+#define BPRED_INSN(PC) ((PC) / sizeof(md_inst_t))
+
+void bpred_ctr_update(unsigned char *ctr, bool taken)
+{
+  if (taken && *ctr < 3)
+  {
+    (*ctr)++;
+  }
+  else if (!taken && *ctr > 0)
+  {
+    (*ctr)--;
   }
-  return;
 }
 
-/* ECE552 Assignment 3 - END CODE */
\ No newline at end of file
+// 2bitsat as in lab 2: 4096 2-bit counters indexed by the low 12 bits of the instruction number
+#define BPRED_2BITSAT_SIZE 4096
+
+void *bpred_2bitsat_init(void)
+{
+  unsigned char *ctr = tom_alloc(BPRED_2BITSAT_SIZE, 1);
+  memset(ctr, BPRED_CTR_WEAK_NOT_TAKEN, BPRED_2BITSAT_SIZE);
+  return ctr;
+}
+
+bool bpred_2bitsat_get(void *state, md_addr_t PC)
+{
+  unsigned char *ctr = state;
+  return ctr[BPRED_INSN(PC) % BPRED_2BITSAT_SIZE] >= 2;
+}
+
+void bpred_2bitsat_update(void *state, md_addr_t PC, bool resolveDir, bool predDir, md_addr_t branchTarget)
+{
+  unsigned char *ctr = state;
+  bpred_ctr_update(&ctr[BPRED_INSN(PC) % BPRED_2BITSAT_SIZE], resolveDir);
+}
+
+// 2level as in lab 2, on the instruction number n: 512 6-bit histories indexed by n[11:3],
+// 8 PHTs of 64 2-bit counters picked by n[2:0] and indexed by the history
+#define BPRED_2LEVEL_BHT_SIZE 512
+#define BPRED_2LEVEL_HIST_BITS 6
+#define BPRED_2LEVEL_PHTS 8
+
+typedef struct
+{
+  unsigned char bht[BPRED_2LEVEL_BHT_SIZE];
+  unsigned char pht[BPRED_2LEVEL_PHTS << BPRED_2LEVEL_HIST_BITS];
+} bpred_2level_t;
+
+void *bpred_2level_init(void)
+{
+  bpred_2level_t *p = tom_alloc(1, sizeof(bpred_2level_t));
+  memset(p->pht, BPRED_CTR_WEAK_NOT_TAKEN, sizeof(p->pht));
+  return p;
+}
+
+unsigned char *bpred_2level_ctr(bpred_2level_t *p, md_addr_t PC)
+{
+  unsigned history = p->bht[(BPRED_INSN(PC) >> 3) % BPRED_2LEVEL_BHT_SIZE];
+  return &p->pht[((BPRED_INSN(PC) % BPRED_2LEVEL_PHTS) << BPRED_2LEVEL_HIST_BITS) | history];
+}
+
+bool bpred_2level_get(void *state, md_addr_t PC)
+{
+  return *bpred_2level_ctr(state, PC) >= 2;
+}
+
+void bpred_2level_update(void *state, md_addr_t PC, bool resolveDir, bool predDir, md_addr_t branchTarget)
+{
+  bpred_2level_t *p = state;
+  bpred_ctr_update(bpred_2level_ctr(p, PC), resolveDir);
+  unsigned char *history = &p->bht[(BPRED_INSN(PC) >> 3) % BPRED_2LEVEL_BHT_SIZE];
+  *history = ((*history << 1) | (resolveDir ? 1 : 0)) & ((1 << BPRED_2LEVEL_HIST_BITS) - 1);
+}
+
+/* ECE552 Assignment 3 - END CODE */
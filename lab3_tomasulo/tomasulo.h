@@ -0,0 +1,39 @@
+#ifndef TOMASULO_H
+#define TOMASULO_H
+
+#include <stdbool.h>
+
+#include "host.h"
+#include "instr.h"
+
+struct opt_odb_t;
+struct stat_sdb_t;
+
+/*
+ * Entry points of the Tomasulo engine. The -tom:* machine parameters
+ * default to the #defines at the top of tomasulo.c, so runTomasulo works
+ * without any of the option hooks. To make them simulator options:
+ *
+ *   sim_reg_options     tomasulo_reg_options(odb);
+ *   sim_check_options   tomasulo_check_options();
+ *   sim_reg_stats       tomasulo_reg_stats(sdb);
+ *   sim_main            runTomasulo(trace), or the stream calls below
+ *                       when tomasulo_stream_enabled()
+ */
+
+void tomasulo_reg_options(struct opt_odb_t *odb);
+void tomasulo_check_options(void);
+void tomasulo_reg_stats(struct stat_sdb_t *sdb);
+
+// simulates the whole trace, returns the total number of cycles
+counter_t runTomasulo(instruction_trace_t *trace);
+
+// -tom:stream, instructions are pushed as the simulator executes them
+// with inst, index, pc, op, r_in, r_out and mem_addr filled in
+bool tomasulo_stream_enabled(void);
+void tomasulo_stream_begin(void (*retire)(instruction_t *instr));
+instruction_t *tomasulo_stream_alloc(void);
+void tomasulo_stream_push(instruction_t *instr);
+counter_t tomasulo_stream_finish(void);
+
+#endif